@@ -0,0 +1,281 @@
+/**
+ * Standalone Yaz0 benchmark, built with `make bench-yaz0`.
+ *
+ * Usage: bench_yaz0.elf [-r REPEAT] [-j THREADS] [file.png ...]
+ *
+ * Compresses every corpus entry at every level and decompresses it again, and prints one CSV line per run:
+ *   corpus,level,bytes,compressed,ratio,encode_mbps,decode_mbps,encoder_bytes,peak_rss_kb,roundtrip
+ * Times are the best of REPEAT runs. encoder_bytes is what the encoder holds after the run, peak_rss_kb the peak of
+ * the whole process so far. The exit code is nonzero if any round trip fails.
+ *
+ * The corpus is a synthetic texture in every TextureType, random data, zeros, and every TextureType each PNG given
+ * on the command line can be converted to.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "generic_buffer.h"
+#include "image_backend.h"
+#include "macros.h"
+#include "png_texture.h"
+#include "yaz0/yaz0.h"
+
+#define SYNTHETIC_SIZE 256
+#define BLOB_SIZE 0x40000
+
+static const char* sLevelNames[] = { "fast", "nintendo", "optimal", "cost" };
+
+static const char* sTextureTypeNames[TextureType_Max] = {
+    [TextureType_rgba16] = "rgba16", [TextureType_rgba32] = "rgba32", [TextureType_i4] = "i4",
+    [TextureType_i8] = "i8",         [TextureType_ia4] = "ia4",       [TextureType_ia8] = "ia8",
+    [TextureType_ia16] = "ia16",     [TextureType_ci4] = "ci4",       [TextureType_ci8] = "ci8",
+};
+
+static int sRepeat = 3;
+static int sThreads = 1;
+static bool sFailed = false;
+
+static double Bench_Now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long Bench_PeakRssKb(void) {
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// small LCG, so the corpus is the same on every machine
+static uint32_t Bench_Random(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+static void Bench_Run(const char* corpus, uint8_t* data, size_t size) {
+    size_t maxSize = size + (size + 7) / 8;
+    uint8_t* compBuffer = malloc(maxSize + 1);
+    uint8_t* decompBuffer = malloc(size + 1);
+    assert(compBuffer != NULL && decompBuffer != NULL);
+
+    for (size_t level = 0; level < ARRAY_COUNT(sLevelNames); level++) {
+        yaz0_encoder encoder;
+        double encodeTime = 0;
+        double decodeTime = 0;
+        int compSize = 0;
+        bool roundTrip = true;
+
+        yaz0_encoder_init(&encoder, (yaz0_level)level, YAZ0_DEFAULT_MAX_CHAIN);
+        encoder.threads = sThreads;
+
+        for (int i = 0; i < sRepeat; i++) {
+            double start = Bench_Now();
+            compSize = yaz0_encoder_encode(&encoder, data, compBuffer, size);
+            double time = Bench_Now() - start;
+
+            if (i == 0 || time < encodeTime) {
+                encodeTime = time;
+            }
+        }
+
+        for (int i = 0; i < sRepeat; i++) {
+            memset(decompBuffer, 0, size);
+
+            double start = Bench_Now();
+            int used = yaz0_decode(compBuffer, compSize, decompBuffer, size);
+            double time = Bench_Now() - start;
+
+            if (i == 0 || time < decodeTime) {
+                decodeTime = time;
+            }
+            if (used != compSize || memcmp(decompBuffer, data, size) != 0) {
+                roundTrip = false;
+            }
+        }
+
+        printf("%s,%s,%zu,%d,%.4f,%.2f,%.2f,%zu,%ld,%s\n", corpus, sLevelNames[level], size, compSize,
+               size != 0 ? (double)compSize / size : 0.0, encodeTime > 0 ? size / encodeTime / 1e6 : 0.0,
+               decodeTime > 0 ? size / decodeTime / 1e6 : 0.0, yaz0_encoder_memory(&encoder), Bench_PeakRssKb(),
+               roundTrip ? "ok" : "FAIL");
+        fflush(stdout);
+
+        if (!roundTrip) {
+            sFailed = true;
+        }
+        yaz0_encoder_destroy(&encoder);
+    }
+
+    free(decompBuffer);
+    free(compBuffer);
+}
+
+static void Bench_RunTexture(const char* name, const ImageBackend* image, TextureType texType) {
+    GenericBuffer buf;
+    char corpus[256];
+
+    snprintf(corpus, sizeof(corpus), "%s/%s", name, sTextureTypeNames[texType]);
+    // 4 bit formats pack pixel pairs, which a row of odd width can't be split into
+    if (PngTexture_BitsPerPixel(texType) % 8 != 0 && image->width % 2 != 0) {
+        fprintf(stderr, "%s: skipped, the width %u is odd\n", corpus, image->width);
+        return;
+    }
+
+    GenericBuffer_Init(&buf);
+    PngTexture_CopyPng(&buf, image, texType);
+
+    Bench_Run(corpus, buf.buffer, buf.bufferLength);
+
+    GenericBuffer_Destroy(&buf);
+}
+
+// runs every TextureType the image can be converted to, the 4 bit ones only for even widths. the color indexed ones
+// come last, since converting the image to them can't be undone
+static void Bench_RunImage(const char* name, ImageBackend* image) {
+    if (!image->isColorIndexed) {
+        for (int texType = 0; texType < TextureType_Max; texType++) {
+            if (texType != TextureType_ci4 && texType != TextureType_ci8) {
+                Bench_RunTexture(name, image, texType);
+            }
+        }
+
+        if (!ImageBackend_ConvertToColorIndexed(image)) {
+            return;
+        }
+    }
+
+    if (image->paletteLen <= 16) {
+        Bench_RunTexture(name, image, TextureType_ci4);
+    }
+    Bench_RunTexture(name, image, TextureType_ci8);
+}
+
+// gradients, flat blocks, a noisy quarter and a transparent cutout, roughly what textures are made of.
+// the palette version only uses 16 colors
+static void Bench_MakeSynthetic(ImageBackend* image, bool palette) {
+    uint32_t seed = 1;
+
+    ImageBackend_InitEmptyRGBImage(image, SYNTHETIC_SIZE, SYNTHETIC_SIZE, true);
+
+    for (uint32_t y = 0; y < SYNTHETIC_SIZE; y++) {
+        for (uint32_t x = 0; x < SYNTHETIC_SIZE; x++) {
+            uint8_t r = x;
+            uint8_t g = y;
+            uint8_t b = (x + y) / 2;
+            uint8_t a = 255;
+
+            if (x < SYNTHETIC_SIZE / 2 && y >= SYNTHETIC_SIZE / 2 && ((x / 32) + (y / 32)) % 2 == 0) {
+                r = 200;
+                g = 40;
+                b = 40;
+            } else if (x >= SYNTHETIC_SIZE / 2 && y >= SYNTHETIC_SIZE / 2) {
+                int noise = (int)(Bench_Random(&seed) % 33) - 16;
+
+                r = (uint8_t)(r + noise);
+                g = (uint8_t)(g + noise);
+            }
+
+            int dx = (int)x - SYNTHETIC_SIZE / 4;
+            int dy = (int)y - SYNTHETIC_SIZE / 4;
+            if (dx * dx + dy * dy < 24 * 24) {
+                a = 0;
+            }
+
+            if (palette) {
+                r = (r / 64) * 85;
+                g = (g / 128) * 255;
+                b = 0;
+                if (a == 0) {
+                    r = g = 0;
+                }
+            }
+
+            ImageBackend_SetRGBPixel(image, y, x, r, g, b, a);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:j:")) != -1) {
+        switch (opt) {
+            case 'r':
+                sRepeat = atoi(optarg);
+                if (sRepeat < 1) {
+                    sRepeat = 1;
+                }
+                break;
+
+            case 'j':
+                sThreads = atoi(optarg);
+                if (sThreads < 1) {
+                    sThreads = 1;
+                } else if (sThreads > YAZ0_MAX_THREADS) {
+                    sThreads = YAZ0_MAX_THREADS;
+                }
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-r REPEAT] [-j THREADS] [file.png ...]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("corpus,level,bytes,compressed,ratio,encode_mbps,decode_mbps,encoder_bytes,peak_rss_kb,roundtrip\n");
+
+    ImageBackend image;
+    ImageBackend_Init(&image);
+    Bench_MakeSynthetic(&image, false);
+    Bench_RunImage("synthetic", &image);
+    ImageBackend_Destroy(&image);
+
+    ImageBackend_Init(&image);
+    Bench_MakeSynthetic(&image, true);
+    Bench_RunImage("synthetic-palette", &image);
+    ImageBackend_Destroy(&image);
+
+    uint8_t* blob = malloc(BLOB_SIZE);
+    assert(blob != NULL);
+    uint32_t seed = 1;
+
+    for (size_t i = 0; i < BLOB_SIZE; i++) {
+        blob[i] = Bench_Random(&seed);
+    }
+    Bench_Run("random", blob, BLOB_SIZE);
+
+    memset(blob, 0, BLOB_SIZE);
+    Bench_Run("zeros", blob, BLOB_SIZE);
+    free(blob);
+
+    for (int i = optind; i < argc; i++) {
+        FILE* inFile = fopen(argv[i], "rb");
+
+        if (inFile == NULL) {
+            fprintf(stderr, "Error: Could not open '%s'\n", argv[i]);
+            sFailed = true;
+            continue;
+        }
+
+        ImageBackend_Init(&image);
+        ImageBackend_ReadPng(&image, inFile);
+        fclose(inFile);
+
+        Bench_RunImage(argv[i], &image);
+        ImageBackend_Destroy(&image);
+    }
+
+    return sFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -22,13 +22,8 @@ void WriteI4PNG(FILE* outputFile, uint8_t* pixelArray, uint32_t width, uint32_t
 
     image.width = width;
     image.height = height;
-    image.pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image.height);
-    {
-        size_t y;
-        for (y = 0; y < image.height; y++) {
-            image.pixelMatrix[y] = (uint8_t*)calloc(image.width / PIXELS_PER_BYTE, sizeof(uint8_t));
-        }
-    }
+    ImageBackend_AllocPixels(&image, image.width / PIXELS_PER_BYTE);
+    memset(image.pixels, 0, image.stride * image.height);
     image.paletteLen = 0;
     image.colorType = PNG_COLOR_TYPE_GRAY;
     image.bitDepth = 4;
@@ -40,7 +35,7 @@ void WriteI4PNG(FILE* outputFile, uint8_t* pixelArray, uint32_t width, uint32_t
         for (row = 0; row < height; row++) {
             size_t column;
             for (column = 0; column < width; column++) {
-                image.pixelMatrix[row][column / PIXELS_PER_BYTE] |= pixelArray[width * row + column]
+                ImageBackend_GetRow(&image, row)[column / PIXELS_PER_BYTE] |= pixelArray[width * row + column]
                                                                     << ((8 / PIXELS_PER_BYTE) - 4 * (column & 1));
             }
         }
@@ -48,7 +43,7 @@ void WriteI4PNG(FILE* outputFile, uint8_t* pixelArray, uint32_t width, uint32_t
         //     size_t column;
         //     // printf("start row %zd\n", row);
         //     for (column = 0; column < width / 2; column++) {
-        //         printf("%02X", image.pixelMatrix[row][column]);
+        //         printf("%02X", ImageBackend_GetRow(&image, row)[column]);
         //     }
         //     puts("");
         //     // printf("row %zd done\n", row);
@@ -9,7 +9,8 @@
 /* ImageBackend */
 
 void ImageBackend_Init(ImageBackend* image) {
-    image->pixelMatrix = NULL;
+    image->pixels = NULL;
+    image->stride = 0;
 
     memset(image->colorPalette, 0, ARRAY_COUNT(image->colorPalette));
     memset(image->alphaPalette, 0, ARRAY_COUNT(image->alphaPalette));
@@ -28,6 +29,38 @@ void ImageBackend_Destroy(ImageBackend* image) {
     ImageBackend_FreeImageData(image);
 }
 
+// all rows in one allocation, each starting IMAGE_BACKEND_ROW_ALIGNMENT aligned, so conversions walk memory linearly.
+// the contents are left uninitialized
+void ImageBackend_AllocPixels(ImageBackend* image, size_t rowBytes) {
+    image->stride = (rowBytes + IMAGE_BACKEND_ROW_ALIGNMENT - 1) / IMAGE_BACKEND_ROW_ALIGNMENT *
+                    IMAGE_BACKEND_ROW_ALIGNMENT;
+
+    size_t size = image->stride * image->height;
+    // aligned_alloc wants a multiple of the alignment, and something to allocate
+    size = (size + IMAGE_BACKEND_ALIGNMENT - 1) / IMAGE_BACKEND_ALIGNMENT * IMAGE_BACKEND_ALIGNMENT;
+    if (size == 0) {
+        size = IMAGE_BACKEND_ALIGNMENT;
+    }
+
+    image->pixels = aligned_alloc(IMAGE_BACKEND_ALIGNMENT, size);
+    assert(image->pixels != NULL);
+}
+
+uint8_t* ImageBackend_GetRow(const ImageBackend* image, size_t y) {
+    return image->pixels + y * image->stride;
+}
+
+// for libpng, which wants a pointer to every row. free() the result
+static png_bytep* ImageBackend_GetRowPointers(const ImageBackend* image) {
+    png_bytep* rows = malloc(sizeof(png_bytep) * (image->height != 0 ? image->height : 1));
+    assert(rows != NULL);
+
+    for (size_t y = 0; y < image->height; y++) {
+        rows[y] = ImageBackend_GetRow(image, y);
+    }
+    return rows;
+}
+
 void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     assert(image != NULL);
     assert(inFile != NULL);
@@ -146,6 +179,12 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     if (image->colorType == PNG_COLOR_TYPE_GRAY && image->bitDepth < 8)
         png_set_expand_gray_1_2_4_to_8(png);
 
+    // one byte per index, rows of packed 1, 2 or 4 bit indices are shorter than the width
+    if (image->colorType == PNG_COLOR_TYPE_PALETTE && image->bitDepth < 8) {
+        png_set_packing(png);
+        image->bitDepth = 8;
+    }
+
     /*if (png_get_valid(png, info, PNG_INFO_tRNS))
         png_set_tRNS_to_alpha(png);*/
 
@@ -161,12 +200,11 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     png_read_update_info(png, info);
 
     size_t rowBytes = png_get_rowbytes(png, info);
-    image->pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image->height);
-    for (size_t y = 0; y < image->height; y++) {
-        image->pixelMatrix[y] = (uint8_t*)malloc(rowBytes);
-    }
+    ImageBackend_AllocPixels(image, rowBytes);
 
-    png_read_image(png, image->pixelMatrix);
+    png_bytep* rows = ImageBackend_GetRowPointers(image);
+    png_read_image(png, rows);
+    free(rows);
 
 #ifdef TEXTURE_DEBUG
     printf("rowBytes: %zu\n", rowBytes);
@@ -177,7 +215,7 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     for (size_t y = 0; y < image->height; y++) {
         for (size_t x = 0; x < image->width; x++) {
             for (size_t z = 0; z < bytePerPixel; z++) {
-                printf("%02X ", image->pixelMatrix[y][x * bytePerPixel + z]);
+                printf("%02X ", ImageBackend_GetRow(image, y)[x * bytePerPixel + z]);
             }
             printf(" ");
         }
@@ -254,14 +292,16 @@ void ImageBackend_WritePng(ImageBackend* image, FILE* outFile) {
     printf("imgData\n");
     for (size_t y = 0; y < image->height; y++) {
         for (size_t x = 0; x < image->width * bytePerPixel; x++) {
-            printf("%02X ", image->pixelMatrix[y][x]);
+            printf("%02X ", ImageBackend_GetRow(image, y)[x]);
         }
         printf("\n");
     }
     printf("\n");
 #endif
 
-    png_write_image(png, image->pixelMatrix);
+    png_bytep* rows = ImageBackend_GetRowPointers(image);
+    png_write_image(png, rows);
+    free(rows);
     png_write_end(png, NULL);
 
     png_destroy_write_struct(&png, &info);
@@ -280,10 +320,8 @@ void ImageBackend_InitEmptyRGBImage(ImageBackend* image, uint32_t nWidth, uint32
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
 
-    image->pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image->height);
-    for (size_t y = 0; y < image->height; y++) {
-        image->pixelMatrix[y] = (uint8_t*)calloc(image->width * bytePerPixel, sizeof(uint8_t*));
-    }
+    ImageBackend_AllocPixels(image, image->width * bytePerPixel);
+    memset(image->pixels, 0, image->stride * image->height);
 
     image->hasImageData = true;
     image->isColorIndexed = false;
@@ -299,10 +337,8 @@ void ImageBackend_InitEmptyPaletteImage(ImageBackend* image, uint32_t nWidth, ui
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
 
-    image->pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image->height);
-    for (size_t y = 0; y < image->height; y++) {
-        image->pixelMatrix[y] = (uint8_t*)calloc(image->width * bytePerPixel, sizeof(uint8_t*));
-    }
+    ImageBackend_AllocPixels(image, image->width * bytePerPixel);
+    memset(image->pixels, 0, image->stride * image->height);
     memset(image->colorPalette, 0, ARRAY_COUNT(image->colorPalette));
     memset(image->alphaPalette, 0, ARRAY_COUNT(image->alphaPalette));
 
@@ -319,11 +355,13 @@ RGBAPixel ImageBackend_GetPixel(const ImageBackend* image, size_t y, size_t x) {
     RGBAPixel_Init(&pixel);
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    pixel.r = image->pixelMatrix[y][x * bytePerPixel + 0];
-    pixel.g = image->pixelMatrix[y][x * bytePerPixel + 1];
-    pixel.b = image->pixelMatrix[y][x * bytePerPixel + 2];
+    const uint8_t* src = ImageBackend_GetRow(image, y) + x * bytePerPixel;
+
+    pixel.r = src[0];
+    pixel.g = src[1];
+    pixel.b = src[2];
     if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-        pixel.a = image->pixelMatrix[y][x * bytePerPixel + 3];
+        pixel.a = src[3];
     }
     return pixel;
 }
@@ -333,7 +371,7 @@ uint8_t ImageBackend_GetIndexedPixel(const ImageBackend* image, size_t y, size_t
     assert(x < image->width);
     assert(image->isColorIndexed);
 
-    return image->pixelMatrix[y][x];
+    return ImageBackend_GetRow(image, y)[x];
 }
 
 RGBAPixel ImageBackend_GetPalettePixel(const ImageBackend* image, size_t index) {
@@ -357,11 +395,13 @@ void ImageBackend_SetRGBPixel(ImageBackend* image, size_t y, size_t x, uint8_t n
     assert(x < image->width);
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    image->pixelMatrix[y][x * bytePerPixel + 0] = nR;
-    image->pixelMatrix[y][x * bytePerPixel + 1] = nG;
-    image->pixelMatrix[y][x * bytePerPixel + 2] = nB;
+    uint8_t* dst = ImageBackend_GetRow(image, y) + x * bytePerPixel;
+
+    dst[0] = nR;
+    dst[1] = nG;
+    dst[2] = nB;
     if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-        image->pixelMatrix[y][x * bytePerPixel + 3] = nA;
+        dst[3] = nA;
     }
 }
 
@@ -371,11 +411,13 @@ void ImageBackend_SetGrayscalePixel(ImageBackend* image, size_t y, size_t x, uin
     assert(x < image->width);
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    image->pixelMatrix[y][x * bytePerPixel + 0] = grayscale;
-    image->pixelMatrix[y][x * bytePerPixel + 1] = grayscale;
-    image->pixelMatrix[y][x * bytePerPixel + 2] = grayscale;
+    uint8_t* dst = ImageBackend_GetRow(image, y) + x * bytePerPixel;
+
+    dst[0] = grayscale;
+    dst[1] = grayscale;
+    dst[2] = grayscale;
     if (image->colorType == PNG_COLOR_TYPE_RGBA)
-        image->pixelMatrix[y][x * bytePerPixel + 3] = alpha;
+        dst[3] = alpha;
 }
 
 void ImageBackend_SetIndexedPixel(ImageBackend* image, size_t y, size_t x, uint8_t index, uint8_t grayscale) {
@@ -384,7 +426,7 @@ void ImageBackend_SetIndexedPixel(ImageBackend* image, size_t y, size_t x, uint8
     assert(x < image->width);
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    image->pixelMatrix[y][x * bytePerPixel + 0] = index;
+    ImageBackend_GetRow(image, y)[x * bytePerPixel + 0] = index;
 
     assert(index < image->paletteLen);
     png_color* pal = (png_color*)image->colorPalette;
@@ -410,6 +452,8 @@ void ImageBackend_SetPalette(ImageBackend* image, const ImageBackend* pal) {
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(pal);
 
     for (size_t y = 0; y < pal->height; y++) {
+        const uint8_t* row = ImageBackend_GetRow(pal, y);
+
         for (size_t x = 0; x < pal->width; x++) {
             size_t index = y * pal->width + x;
             if (index >= image->paletteLen) {
@@ -421,10 +465,10 @@ void ImageBackend_SetPalette(ImageBackend* image, const ImageBackend* pal) {
                 return;
             }
 
-            uint8_t r = pal->pixelMatrix[y][x * bytePerPixel + 0];
-            uint8_t g = pal->pixelMatrix[y][x * bytePerPixel + 1];
-            uint8_t b = pal->pixelMatrix[y][x * bytePerPixel + 2];
-            uint8_t a = pal->pixelMatrix[y][x * bytePerPixel + 3];
+            uint8_t r = row[x * bytePerPixel + 0];
+            uint8_t g = row[x * bytePerPixel + 1];
+            uint8_t b = row[x * bytePerPixel + 2];
+            uint8_t a = row[x * bytePerPixel + 3];
             ImageBackend_SetPaletteIndex(image, index, r, g, b, a);
         }
     }
@@ -438,16 +482,18 @@ bool ImageBackend_ConvertToColorIndexed(ImageBackend* image) {
 
     // Create palette
     for (size_t y = 0; y < image->height; y++) {
+        uint8_t* row = ImageBackend_GetRow(image, y);
+
         for (size_t x = 0; x < image->width; x++) {
             RGBAPixel pixel;
             RGBAPixel_Init(&pixel);
 
-            pixel.r = image->pixelMatrix[y][x * bytePerPixel + 0];
-            pixel.g = image->pixelMatrix[y][x * bytePerPixel + 1];
-            pixel.b = image->pixelMatrix[y][x * bytePerPixel + 2];
+            pixel.r = row[x * bytePerPixel + 0];
+            pixel.g = row[x * bytePerPixel + 1];
+            pixel.b = row[x * bytePerPixel + 2];
             pixel.a = 255;
             if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-                pixel.a = image->pixelMatrix[y][x * bytePerPixel + 3];
+                pixel.a = row[x * bytePerPixel + 3];
             }
 
             bool wasColorPreviouslyAdded = false;
@@ -479,16 +525,18 @@ bool ImageBackend_ConvertToColorIndexed(ImageBackend* image) {
 
     // Palettize the pixel matrix
     for (size_t y = 0; y < image->height; y++) {
+        uint8_t* row = ImageBackend_GetRow(image, y);
+
         for (size_t x = 0; x < image->width; x++) {
             RGBAPixel pixel;
             RGBAPixel_Init(&pixel);
 
-            pixel.r = image->pixelMatrix[y][x * bytePerPixel + 0];
-            pixel.g = image->pixelMatrix[y][x * bytePerPixel + 1];
-            pixel.b = image->pixelMatrix[y][x * bytePerPixel + 2];
+            pixel.r = row[x * bytePerPixel + 0];
+            pixel.g = row[x * bytePerPixel + 1];
+            pixel.b = row[x * bytePerPixel + 2];
             pixel.a = 255;
             if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-                pixel.a = image->pixelMatrix[y][x * bytePerPixel + 3];
+                pixel.a = row[x * bytePerPixel + 3];
             }
 
             for (size_t i = 0; i < paletteMax; i++) {
@@ -496,13 +544,13 @@ bool ImageBackend_ConvertToColorIndexed(ImageBackend* image) {
 
                 if (tempPixel->r == pixel.r && tempPixel->g == pixel.g && tempPixel->b == pixel.b) {
                     if (image->alphaPalette[i] == pixel.a) {
-                        //image->pixelMatrix[y][x * bytePerPixel + 0] = i;
-                        //image->pixelMatrix[y][x * bytePerPixel + 1] = i;
-                        //image->pixelMatrix[y][x * bytePerPixel + 2] = i;
+                        //row[x * bytePerPixel + 0] = i;
+                        //row[x * bytePerPixel + 1] = i;
+                        //row[x * bytePerPixel + 2] = i;
                         //if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-                        //    image->pixelMatrix[y][x * bytePerPixel + 3] = i;
+                        //    row[x * bytePerPixel + 3] = i;
                         //}
-                        image->pixelMatrix[y][x] = i;
+                        row[x] = i;
                         break;
                     }
                 }
@@ -541,11 +589,9 @@ double ImageBackend_GetBytesPerPixel(const ImageBackend* image) {
 
 void ImageBackend_FreeImageData(ImageBackend* image) {
     if (image->hasImageData) {
-        for (size_t y = 0; y < image->height; y++) {
-            free(image->pixelMatrix[y]);
-        }
-        free(image->pixelMatrix);
-        image->pixelMatrix = NULL;
+        free(image->pixels);
+        image->pixels = NULL;
+        image->stride = 0;
     }
 
     if (image->isColorIndexed) {
@@ -24,8 +24,12 @@ typedef struct RGBPixel {
     uint8_t b;
 } RGBPixel;
 
+#define IMAGE_BACKEND_ALIGNMENT 64     // of the pixel allocation
+#define IMAGE_BACKEND_ROW_ALIGNMENT 16 // of every row in it
+
 typedef struct ImageBackend {
-    uint8_t** pixelMatrix; // height * [width * bytePerPixel]
+    uint8_t* pixels; // height rows of width * bytePerPixel bytes, stride bytes apart, in one allocation
+    size_t stride;
 
     RGBPixel colorPalette[256];
     uint8_t alphaPalette[256];
@@ -45,6 +49,9 @@ typedef struct ImageBackend {
 void ImageBackend_Init(ImageBackend* image);
 void ImageBackend_Destroy(ImageBackend* image);
 
+void ImageBackend_AllocPixels(ImageBackend* image, size_t rowBytes);
+uint8_t* ImageBackend_GetRow(const ImageBackend* image, size_t y);
+
 void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile);
 void ImageBackend_WritePng(ImageBackend* image, FILE* outFile);
 
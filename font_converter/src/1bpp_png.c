@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <png.h>
 
 #include "image_backend.h"
@@ -12,13 +13,8 @@ void Write1bppPNG(FILE* outputFile, uint8_t* pixelArray, uint32_t width, uint32_
 
     image.width = width;
     image.height = height;
-    image.pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image.height);
-    {
-        size_t y;
-        for (y = 0; y < image.height; y++) {
-            image.pixelMatrix[y] = (uint8_t*)calloc(image.width / 8, sizeof(uint8_t));
-        }
-    }
+    ImageBackend_AllocPixels(&image, image.width / 8);
+    memset(image.pixels, 0, image.stride * image.height);
     image.paletteLen = 0;
     image.colorType = PNG_COLOR_TYPE_GRAY;
     image.bitDepth = 1;
@@ -32,7 +28,7 @@ void Write1bppPNG(FILE* outputFile, uint8_t* pixelArray, uint32_t width, uint32_
             printf("start row %zd\n", row);
             for (column = 0; column < width; column++) {
                 // printf("%d\n", pixelArray[width * row + column] << (7 - column & 7));
-                image.pixelMatrix[row][column / 8] |= pixelArray[width * row + column] << (7 - column & 7);
+                ImageBackend_GetRow(&image, row)[column / 8] |= pixelArray[width * row + column] << (7 - column & 7);
             }
             printf("row %zd done\n", row);
         }
@@ -17,3 +17,8 @@ int64_t ToInt64BE(const uint8_t* data, int32_t offset);
 uint64_t ToUInt64BE(const uint8_t* data, int32_t offset);
 
 void FromUInt32ToBE(uint8_t* data, int32_t offset, uint32_t value);
+
+void SwapUInt16Array(uint8_t* data, size_t count);
+void SwapUInt32Array(uint8_t* data, size_t count);
+void SwapUInt64Array(uint8_t* data, size_t count);
+void SwapArrayElements(uint8_t* data, size_t count, size_t elementSize);
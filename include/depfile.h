@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Make style dependency files, as written by gcc -MD, which make and ninja can both read
+
+void Depfile_Write(FILE* outFile, const char* const* targets, size_t targetCount, const char* const* prerequisites,
+                   size_t prerequisiteCount);
+char* Depfile_GetToolPath(const char* argv0);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "generic_buffer.h"
+
+typedef enum ElfTarget {
+    ElfTarget_Mips, // 32 bit big endian, o32 MIPS III like the N64
+    ElfTarget_Host, // the machine texture2c was built for
+} ElfTarget;
+
+bool ElfObject_Write(const GenericBuffer* buffer, FILE* outFile, ElfTarget target, const char* sectionName,
+                     const char* symbolName, size_t elementSize, size_t alignment);
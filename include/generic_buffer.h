@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "yaz0/yaz0.h"
+
 typedef enum TypeBitWidth {
     TypeBitWidth_8,
     TypeBitWidth_16,
@@ -13,6 +15,18 @@ typedef enum TypeBitWidth {
     TypeBitWidth_Max,
 } TypeBitWidth;
 
+typedef enum CArrayStyle {
+    CArrayStyle_Hex,     // "    0x0011, 0x2233, "
+    CArrayStyle_Compact, // "17,8755,"
+    CArrayStyle_String,  // "\21\0AB", 8 bit only
+} CArrayStyle;
+
+typedef enum CompressionFormat {
+    CompressionFormat_Yaz0,
+    CompressionFormat_Mio0,
+    CompressionFormat_Yay0,
+} CompressionFormat;
+
 typedef struct GenericBuffer {
     uint8_t* buffer;
     size_t bufferSize;   // Size of the allocated buffer
@@ -25,7 +39,22 @@ void GenericBuffer_Init(GenericBuffer* buffer);
 void GenericBuffer_Destroy(GenericBuffer* buffer);
 
 void GenericBuffer_WriteAsRawCArray(GenericBuffer* buffer, TypeBitWidth bitWidth, FILE* outFile);
+void GenericBuffer_WriteAsRawCArrayStyled(GenericBuffer* buffer, TypeBitWidth bitWidth, CArrayStyle style,
+                                          bool skipZeros, FILE* outFile, int threads);
+void GenericBuffer_Pad(GenericBuffer* buffer, size_t alignment, uint8_t fill);
+void GenericBuffer_SwapElements(GenericBuffer* buffer, TypeBitWidth bitWidth);
+void GenericBuffer_WriteBinary(GenericBuffer* buffer, FILE* outFile);
 void GenericBuffer_ReadBinary(GenericBuffer* buffer, FILE* inFile);
 
-void GenericBuffer_Yaz0Compress(GenericBuffer* buffer);
-void GenericBuffer_Yaz0Decompress(GenericBuffer* buffer);
+void GenericBuffer_Yaz0Compress(GenericBuffer* buffer, yaz0_encoder* encoder);
+bool GenericBuffer_Yaz0CompressFile(GenericBuffer* buffer, FILE* inFile, yaz0_encoder* encoder);
+bool GenericBuffer_Yaz0CompressFileTo(FILE* inFile, FILE* outFile, yaz0_encoder* encoder);
+bool GenericBuffer_Yaz0Decompress(GenericBuffer* buffer);
+void GenericBuffer_Mio0Compress(GenericBuffer* buffer, yaz0_encoder* encoder);
+bool GenericBuffer_Mio0Decompress(GenericBuffer* buffer);
+void GenericBuffer_Yay0Compress(GenericBuffer* buffer, yaz0_encoder* encoder);
+bool GenericBuffer_Yay0Decompress(GenericBuffer* buffer);
+
+void GenericBuffer_Compress(GenericBuffer* buffer, CompressionFormat format, yaz0_encoder* encoder);
+bool GenericBuffer_Decompress(GenericBuffer* buffer);
+void GenericBuffer_PrintCompressionStats(const GenericBuffer* buffer, const yaz0_cost_model* model, FILE* outFile);
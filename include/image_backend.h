@@ -23,8 +23,23 @@ typedef struct RGBPixel {
     uint8_t b;
 } RGBPixel;
 
+// how the bytes of a row are laid out, once ReadPng has expanded the png
+typedef enum ImageLayout {
+    ImageLayout_RGB,       // 3 bytes per pixel
+    ImageLayout_RGBA,      // 4 bytes per pixel
+    ImageLayout_Gray,      // 1 byte per pixel, 1, 2 and 4 bit gray is expanded to this
+    ImageLayout_GrayAlpha, // 2 bytes per pixel, gray then alpha
+    ImageLayout_Indexed,   // 1 palette index per pixel, 1 and 2 bit indices are expanded to this
+    ImageLayout_Indexed4,  // 2 palette indices per byte, the first one in the high nibble, as in a 4 bit png
+    ImageLayout_Max,
+} ImageLayout;
+
+#define IMAGE_BACKEND_ALIGNMENT 64     // of the pixel allocation
+#define IMAGE_BACKEND_ROW_ALIGNMENT 16 // of every row in it
+
 typedef struct ImageBackend {
-    uint8_t** pixelMatrix; // height * [width * bytePerPixel]
+    uint8_t* pixels; // height rows of width * bytePerPixel bytes, stride bytes apart, in one allocation
+    size_t stride;
 
     RGBPixel colorPalette[256];
     uint8_t alphaPalette[256];
@@ -44,7 +59,13 @@ typedef struct ImageBackend {
 void ImageBackend_Init(ImageBackend* image);
 void ImageBackend_Destroy(ImageBackend* image);
 
+void ImageBackend_AllocPixels(ImageBackend* image, size_t rowBytes);
+uint8_t* ImageBackend_GetRow(const ImageBackend* image, size_t y);
+const uint8_t* ImageBackend_GetSpan(const ImageBackend* image, size_t y, size_t x, size_t count);
+ImageLayout ImageBackend_GetLayout(const ImageBackend* image);
+
 void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile);
+void ImageBackend_ReadPngRGBA8(ImageBackend* image, FILE* inFile, bool keepPalette);
 void ImageBackend_WritePng(ImageBackend* image, FILE* outFile);
 
 void ImageBackend_InitEmptyRGBImage(ImageBackend* image, uint32_t nWidth, uint32_t nHeight, bool alpha);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// an output that can be rendered into memory first and only replace the file on disk if its contents changed, so
+// build tools don't see a new timestamp for the same bytes
+typedef struct OutputFile {
+    const char* path;
+    FILE* file;
+    bool ifChanged;
+    char* data; // what was written, when ifChanged
+    size_t size;
+} OutputFile;
+
+bool OutputFile_Open(OutputFile* out, const char* path, bool ifChanged);
+bool OutputFile_Close(OutputFile* out);
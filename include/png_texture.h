@@ -25,3 +25,5 @@ void PngTexture_CopyPng(GenericBuffer* dst, const ImageBackend* textureData, Tex
 void PngTexture_CopyPalette(GenericBuffer* dst, const ImageBackend* textureData);
 
 uint32_t PngTexture_BitsPerPixel(TextureType texType);
+
+bool PngTexture_SelfCheck(void);
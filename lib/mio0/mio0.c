@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mio0.h"
+
+// every read is checked against srcSize, every copy against uncompressedSize
+int mio0_decode(const uint8_t* src, int srcSize, uint32_t linkOffset, uint32_t chunkOffset, uint8_t* dst,
+                int uncompressedSize)
+{
+    uint32_t size = srcSize;
+    uint32_t flagPlace = MIO0_HEADER_SIZE, linkPlace = linkOffset, chunkPlace = chunkOffset;
+    int dstPlace = 0;
+
+    if (linkOffset > size || chunkOffset > size)
+        return -1;
+
+    unsigned int validBitCount = 0;  // number of valid bits left in the flag word
+    uint32_t flags = 0;
+    while (dstPlace < uncompressedSize)
+    {
+        if (validBitCount == 0)
+        {
+            if (flagPlace + 4 > size)
+                return -1;
+            flags = ((uint32_t)src[flagPlace] << 24) | (src[flagPlace + 1] << 16) | (src[flagPlace + 2] << 8) |
+                    src[flagPlace + 3];
+            flagPlace += 4;
+            validBitCount = 32;
+        }
+
+        if ((flags & 0x80000000) != 0)
+        {
+            // straight copy
+            if (chunkPlace >= size)
+                return -1;
+            dst[dstPlace] = src[chunkPlace];
+            dstPlace++;
+            chunkPlace++;
+        }
+        else
+        {
+            if (linkPlace + 2 > size)
+                return -1;
+            uint8_t byte1 = src[linkPlace];
+            uint8_t byte2 = src[linkPlace + 1];
+            linkPlace += 2;
+
+            int dist = (((byte1 & 0xF) << 8) | byte2) + 1;
+
+            int numBytes = (byte1 >> 4) + 3;
+
+            if (dist > dstPlace || numBytes > uncompressedSize - dstPlace)
+                return -1;
+
+            // byte by byte, the run may overlap itself
+            for (int i = 0; i < numBytes; i++)
+                dst[dstPlace + i] = dst[dstPlace - dist + i];
+            dstPlace += numBytes;
+        }
+
+        flags <<= 1;
+        validBitCount -= 1;
+    }
+
+    return 0;
+}
+
+int mio0_encode(yaz0_encoder *enc, uint8_t *src, uint8_t *dest, int srcSize, uint32_t *linkOffset,
+                uint32_t *chunkOffset)
+{
+    // the yaz0 encoder chooses the codes, limited to the lengths a link can
+    // hold and sized as links. they only need to be recoded and sorted into
+    // the three streams
+    uint8_t *codes = malloc(srcSize + (srcSize + 7) / 8 + 1);
+    assert(codes != NULL);
+    int maxMatch = enc->maxMatch;
+    int longCodeMin = enc->longCodeMin;
+    enc->maxMatch = MIO0_MAX_MATCH;
+    enc->longCodeMin = MIO0_MAX_MATCH + 1;
+    int codesSize = yaz0_encoder_encode(enc, src, codes, srcSize);
+    enc->maxMatch = maxMatch;
+    enc->longCodeMin = longCodeMin;
+
+    // links take at most two bytes for every three input bytes, so both
+    // streams fit in srcSize. the flags go straight to dest
+    uint8_t *links = malloc(2 * srcSize + 1);
+    assert(links != NULL);
+    uint8_t *chunks = links + srcSize;
+    uint8_t *flags = dest + MIO0_HEADER_SIZE;
+    int linkSize = 0, chunkSize = 0, flagCount = 0;
+
+    int codePlace = 0, dstPlace = 0;
+    unsigned int validBitCount = 0;
+    uint8_t currCodeByte = 0;
+    while (dstPlace < srcSize)
+    {
+        if (validBitCount == 0)
+        {
+            currCodeByte = codes[codePlace++];
+            validBitCount = 8;
+        }
+
+        if (flagCount % 32 == 0)
+            memset(flags + flagCount / 8, 0, 4);
+
+        if ((currCodeByte & 0x80) != 0)
+        {
+            flags[flagCount / 8] |= 0x80 >> (flagCount % 8);
+            chunks[chunkSize++] = codes[codePlace++];
+            dstPlace++;
+        }
+        else
+        {
+            // same distance, but the length is stored minus 3 instead of 2,
+            // which lets 18 fit in a link
+            uint8_t byte1 = codes[codePlace];
+            int dist = ((byte1 & 0xF) << 8) | codes[codePlace + 1];
+            int numBytes = byte1 >> 4;
+            codePlace += 2;
+
+            if (numBytes == 0)
+                numBytes = codes[codePlace++] + 0x12;
+            else
+                numBytes += 2;
+            assert(numBytes <= MIO0_MAX_MATCH);
+
+            links[linkSize++] = ((numBytes - 3) << 4) | (dist >> 8);
+            links[linkSize++] = dist & 0xFF;
+            dstPlace += numBytes;
+        }
+
+        flagCount++;
+        currCodeByte <<= 1;
+        validBitCount -= 1;
+    }
+    assert(codePlace <= codesSize);
+
+    *linkOffset = MIO0_HEADER_SIZE + (flagCount + 31) / 32 * 4;
+    *chunkOffset = *linkOffset + linkSize;
+    memcpy(dest + *linkOffset, links, linkSize);
+    memcpy(dest + *chunkOffset, chunks, chunkSize);
+
+    free(links);
+    free(codes);
+
+    return *chunkOffset + chunkSize;
+}
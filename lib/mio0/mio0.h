@@ -0,0 +1,32 @@
+#ifndef _MIO0_H_
+#define _MIO0_H_
+
+#include <stdint.h>
+
+#include "yaz0/yaz0.h"
+
+// MIO0 splits its codes into three streams: 32 bit words of flags
+// (1 = straight copy), 16 bit links holding length and distance, and the
+// straight copied bytes. links are 3 to 18 bytes long.
+// the header is "MIO0", the uncompressed size, and the offsets of the links
+// and the bytes, all big endian. the flags start right after it
+#define MIO0_HEADER_SIZE 16
+
+#define MIO0_MAX_MATCH 18
+
+// largest possible file for srcSize input bytes, header included
+#define MIO0_MAX_SIZE(srcSize) (MIO0_HEADER_SIZE + (((srcSize) + 31) / 32) * 4 + (srcSize))
+
+// src is the whole file, linkOffset and chunkOffset come from its header.
+// returns 0, or -1 if the data is not a valid stream
+int mio0_decode(const uint8_t* src, int srcSize, uint32_t linkOffset, uint32_t chunkOffset, uint8_t* dst,
+                int uncompressedSize);
+
+// compresses src into dest, which must hold MIO0_MAX_SIZE(srcSize) bytes. the
+// matches are chosen by enc, limited to MIO0_MAX_MATCH.
+// the header is left for the caller to write, with the offsets returned here.
+// returns the size of the whole file
+int mio0_encode(yaz0_encoder *enc, uint8_t *src, uint8_t *dest, int srcSize, uint32_t *linkOffset,
+                uint32_t *chunkOffset);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _YAY0_H_
+#define _YAY0_H_
+
+#include <stdint.h>
+
+#include "yaz0/yaz0.h"
+
+// Yay0 has the same codes as yaz0, split into three streams: 32 bit words of
+// flags (1 = straight copy), 16 bit links holding length and distance, and
+// bytes holding the straight copies and the lengths of long links.
+// the header is "Yay0", the uncompressed size, and the offsets of the links
+// and the bytes, all big endian. the flags start right after it
+#define YAY0_HEADER_SIZE 16
+
+// largest possible file for srcSize input bytes, header included
+#define YAY0_MAX_SIZE(srcSize) (YAY0_HEADER_SIZE + (((srcSize) + 31) / 32) * 4 + (srcSize))
+
+// src is the whole file, linkOffset and chunkOffset come from its header.
+// returns 0, or -1 if the data is not a valid stream
+int yay0_decode(const uint8_t* src, int srcSize, uint32_t linkOffset, uint32_t chunkOffset, uint8_t* dst,
+                int uncompressedSize);
+
+// compresses src into dest, which must hold YAY0_MAX_SIZE(srcSize) bytes. the
+// matches are chosen by enc, so every level works the same as for yaz0.
+// the header is left for the caller to write, with the offsets returned here.
+// returns the size of the whole file
+int yay0_encode(yaz0_encoder *enc, uint8_t *src, uint8_t *dest, int srcSize, uint32_t *linkOffset,
+                uint32_t *chunkOffset);
+
+#endif
@@ -1,34 +1,57 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "yaz0.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define YAZ0_X86_SIMD
+#endif
+
 // decoder implementation by thakis of http://www.amnoid.de
 
 // src points to the yaz0 source data (to the "real" source data, not at the header!)
 // dst points to a buffer uncompressedSize bytes large (you get uncompressedSize from
 // the second 4 bytes in the Yaz0 header).
-void yaz0_decode(uint8_t* src, uint8_t* dst, int uncompressedSize)
+// every read and every copy is checked against srcSize and uncompressedSize.
+// returns the number of source bytes used, or -1 if the data is not a valid stream
+int yaz0_decode(const uint8_t* src, int srcSize, uint8_t* dst, int uncompressedSize)
 {
     int srcPlace = 0, dstPlace = 0;  // current read/write positions
 
     unsigned int validBitCount = 0;  // number of valid bits left in "code" byte
-    uint8_t currCodeByte;
+    uint8_t currCodeByte = 0;
     while (dstPlace < uncompressedSize)
     {
         // read new "code" byte if the current one is used up
         if (validBitCount == 0)
         {
+            if (srcPlace >= srcSize)
+                return -1;
             currCodeByte = src[srcPlace];
             ++srcPlace;
             validBitCount = 8;
+
+            // eight straight copies in a row
+            if (currCodeByte == 0xFF && srcPlace + 8 <= srcSize && dstPlace + 8 <= uncompressedSize)
+            {
+                memcpy(dst + dstPlace, src + srcPlace, 8);
+                srcPlace += 8;
+                dstPlace += 8;
+                validBitCount = 0;
+                continue;
+            }
         }
 
         if ((currCodeByte & 0x80) != 0)
         {
             // straight copy
+            if (srcPlace >= srcSize)
+                return -1;
             dst[dstPlace] = src[srcPlace];
             dstPlace++;
             srcPlace++;
@@ -36,16 +59,19 @@ void yaz0_decode(uint8_t* src, uint8_t* dst, int uncompressedSize)
         else
         {
             // RLE part
+            if (srcPlace + 2 > srcSize)
+                return -1;
             uint8_t byte1 = src[srcPlace];
             uint8_t byte2 = src[srcPlace + 1];
             srcPlace += 2;
 
-            unsigned int dist = ((byte1 & 0xF) << 8) | byte2;
-            unsigned int copySource = dstPlace - (dist + 1);
+            int dist = (((byte1 & 0xF) << 8) | byte2) + 1;
 
-            unsigned int numBytes = byte1 >> 4;
+            int numBytes = byte1 >> 4;
             if (numBytes == 0)
             {
+                if (srcPlace >= srcSize)
+                    return -1;
                 numBytes = src[srcPlace] + 0x12;
                 srcPlace++;
             }
@@ -54,19 +80,99 @@ void yaz0_decode(uint8_t* src, uint8_t* dst, int uncompressedSize)
                 numBytes += 2;
             }
 
+            if (dist > dstPlace || numBytes > uncompressedSize - dstPlace)
+                return -1;
+
+            uint8_t* out = dst + dstPlace;
+            const uint8_t* copySource = out - dist;
+
             // copy run
-            for (unsigned int i = 0; i < numBytes; ++i)
+            if (dist == 1)
+            {
+                memset(out, *copySource, numBytes);
+            }
+            else if (dist >= numBytes)
+            {
+                memcpy(out, copySource, numBytes);
+            }
+            else
             {
-                dst[dstPlace] = dst[copySource];
-                copySource++;
-                dstPlace++;
+                // overlapping copy: the bytes already written repeat every dist bytes,
+                // so each pass can copy everything written so far
+                int done = 0;
+                while (done < numBytes)
+                {
+                    int chunk = dist + done;
+                    if (chunk > numBytes - done)
+                        chunk = numBytes - done;
+
+                    memcpy(out + done, copySource, chunk);
+                    done += chunk;
+                }
             }
+            dstPlace += numBytes;
         }
 
         // use next bit from "code" byte
         currCodeByte <<= 1;
         validBitCount -= 1;
     }
+
+    return srcPlace;
+}
+
+// walks a yaz0 stream like yaz0_decode and adds up what decoding it costs
+// according to model. the byte weight isn't included
+uint64_t yaz0_decode_cost(const uint8_t* src, int srcSize, int uncompressedSize, const yaz0_cost_model* model)
+{
+    int srcPlace = 0, dstPlace = 0;
+    unsigned int validBitCount = 0;
+    uint8_t currCodeByte = 0;
+    uint64_t cycles = 0;
+
+    while (dstPlace < uncompressedSize && srcPlace < srcSize)
+    {
+        if (validBitCount == 0)
+        {
+            currCodeByte = src[srcPlace++];
+            validBitCount = 8;
+            continue;
+        }
+
+        if ((currCodeByte & 0x80) != 0)
+        {
+            cycles += model->literal;
+            dstPlace++;
+            srcPlace++;
+        }
+        else
+        {
+            if (srcPlace + 2 > srcSize)
+                break;
+
+            int numBytes = src[srcPlace] >> 4;
+            srcPlace += 2;
+            if (numBytes == 0)
+            {
+                if (srcPlace >= srcSize)
+                    break;
+                numBytes = src[srcPlace++] + 0x12;
+                cycles += model->longMatch;
+            }
+            else
+            {
+                numBytes += 2;
+                cycles += model->shortMatch;
+            }
+            cycles += (uint64_t)model->copiedByte * numBytes;
+            dstPlace += numBytes;
+        }
+
+        currCodeByte <<= 1;
+        validBitCount -= 1;
+    }
+
+    return cycles;
 }
 
 // encoder implementation by shevious, with bug fixes by notwa
@@ -76,35 +182,234 @@ typedef uint8_t uint8_t;
 
 #define MAX_RUNLEN (0xFF + 0x12)
 
-// simple and straight encoding scheme for Yaz0
-static uint32_t simpleEnc(uint8_t *src, int size, int pos, uint32_t *pMatchPos)
+#define WINDOW_SIZE 0x1000
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+#define MIN_MATCH 3
+
+// the optimal levels try a match at least this long only whole, as the longest
+// 2 byte code and as the shortest 3 byte code, instead of at every length. the
+// match one position later is at most one byte shorter, so cutting a long match
+// anywhere else hardly ever saves a byte
+#define NICE_MATCH 64
+
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+
+// returns how many bytes at the start of a and b are equal, up to limit
+typedef int (*match_length_func)(const uint8_t *a, const uint8_t *b, int limit);
+
+static int matchLengthScalar(const uint8_t *a, const uint8_t *b, int limit)
+{
+    int j = 0;
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__)
+    // compare a word at a time, the first differing bit tells the length
+    while (j + 8 <= limit)
+    {
+        uint64_t x, y;
+
+        memcpy(&x, a + j, sizeof(x));
+        memcpy(&y, b + j, sizeof(y));
+        if (x != y)
+        {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return j + __builtin_ctzll(x ^ y) / 8;
+#else
+            return j + __builtin_clzll(x ^ y) / 8;
+#endif
+        }
+        j += 8;
+    }
+#endif
+
+    while (j < limit && a[j] == b[j])
+        j++;
+
+    return j;
+}
+
+#ifdef YAZ0_X86_SIMD
+__attribute__((target("sse2"))) static int matchLengthSse2(const uint8_t *a, const uint8_t *b, int limit)
+{
+    int j = 0;
+
+    while (j + 16 <= limit)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + j));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + j));
+        unsigned int diff = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFF;
+
+        if (diff != 0)
+            return j + __builtin_ctz(diff);
+        j += 16;
+    }
+
+    return j + matchLengthScalar(a + j, b + j, limit - j);
+}
+
+__attribute__((target("avx2"))) static int matchLengthAvx2(const uint8_t *a, const uint8_t *b, int limit)
+{
+    int j = 0;
+
+    while (j + 32 <= limit)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + j));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + j));
+        unsigned int diff = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+
+        if (diff != 0)
+        {
+            _mm256_zeroupper();
+            return j + __builtin_ctz(diff);
+        }
+        j += 32;
+    }
+
+    // gcc doesn't clear the upper halves of the registers for functions with
+    // a target attribute, and leaving them dirty makes every SSE instruction
+    // after this one slow, the ones of matchLengthSse2 included
+    _mm256_zeroupper();
+    return j + matchLengthSse2(a + j, b + j, limit - j);
+}
+#endif
+
+// picks the widest compare the cpu we run on supports
+static match_length_func selectMatchLength(void)
+{
+#ifdef YAZ0_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return matchLengthAvx2;
+    if (__builtin_cpu_supports("sse2"))
+        return matchLengthSse2;
+#endif
+
+    return matchLengthScalar;
+}
+
+// hash chain match finder, keyed on the first 3 bytes of every position.
+// head holds the most recent position for each hash, prev links each position
+// to the previous one with the same hash. prev is indexed modulo the window,
+// which is fine because older positions are never looked at.
+typedef struct match_finder
+{
+    int head[HASH_SIZE];
+    int prev[WINDOW_SIZE];
+    int nextInsert; // first position that is not in the chains yet
+    int maxChain;   // maximum number of candidates examined per position
+    int maxMatch;   // longest match the output format can code
+    match_length_func matchLength;
+} match_finder;
+
+static void matchFinderInit(match_finder *mf, int maxChain, int maxMatch)
+{
+    for (int i = 0; i < HASH_SIZE; i++)
+        mf->head[i] = -1;
+
+    mf->nextInsert = 0;
+    mf->maxChain = maxChain > 0 ? maxChain : 1;
+    mf->maxMatch = maxMatch >= MIN_MATCH && maxMatch < MAX_RUNLEN ? maxMatch : MAX_RUNLEN;
+    mf->matchLength = selectMatchLength();
+}
+
+static uint32_t hash3(const uint8_t *p)
+{
+    uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// add every position before pos to the hash chains.
+// positions whose 3 bytes aren't all in src yet are left for a later call
+static void matchFinderInsert(match_finder *mf, uint8_t *src, int size, int pos)
+{
+    int last = size - MIN_MATCH;
+
+    if (pos - 1 < last)
+        last = pos - 1;
+
+    for (int i = mf->nextInsert; i <= last; i++)
+    {
+        uint32_t h = hash3(src + i);
+
+        mf->prev[i & WINDOW_MASK] = mf->head[h];
+        mf->head[h] = i;
+    }
+
+    if (mf->nextInsert < last + 1)
+        mf->nextInsert = last + 1;
+}
+
+// move every position in the chains shift bytes back.
+// shift must be a multiple of the window size so prev keeps its indexing
+static void matchFinderSlide(match_finder *mf, int shift)
+{
+    for (int i = 0; i < HASH_SIZE; i++)
+        mf->head[i] = mf->head[i] >= shift ? mf->head[i] - shift : -1;
+
+    for (int i = 0; i < WINDOW_SIZE; i++)
+        mf->prev[i] = mf->prev[i] >= shift ? mf->prev[i] - shift : -1;
+
+    mf->nextInsert -= shift;
+}
+
+// find the longest match for pos inside the window.
+// searches must happen at increasing positions, so the chains never contain pos itself
+static uint32_t simpleEnc(match_finder *mf, uint8_t *src, int size, int pos, uint32_t *pMatchPos)
 {
     int numBytes = 1;
     int matchPos = 0;
 
-    int startPos = pos - 0x1000;
+    int startPos = pos - WINDOW_SIZE;
     int end = size - pos;
 
     if (startPos < 0)
         startPos = 0;
 
-    // maximum runlength for 3 byte encoding
-    if (end > MAX_RUNLEN)
-        end = MAX_RUNLEN;
+    // maximum runlength for 3 byte encoding, or less for other formats
+    if (end > mf->maxMatch)
+        end = mf->maxMatch;
 
-    for (int i = startPos; i < pos; i++)
-    {
-        int j;
+    matchFinderInsert(mf, src, size, pos);
 
-        for (j = 0; j < end; j++)
+    if (end >= MIN_MATCH)
+    {
+        // runs of one or two repeating bytes (flat colours, padding) are
+        // checked first. if they already reach the maximum length, the window
+        // doesn't need to be searched at all
+        for (int dist = 1; dist <= 2 && dist <= pos; dist++)
         {
-            if (src[i + j] != src[j + pos])
-                break;
+            int j = mf->matchLength(src + pos - dist, src + pos, end);
+
+            if (j > numBytes)
+            {
+                numBytes = j;
+                matchPos = pos - dist;
+            }
         }
-        if (j > numBytes)
+    }
+
+    if (end >= MIN_MATCH && numBytes < end)
+    {
+        int chain = mf->maxChain;
+
+        for (int i = mf->head[hash3(src + pos)]; i >= startPos && chain > 0; i = mf->prev[i & WINDOW_MASK], chain--)
         {
-            numBytes = j;
-            matchPos = i;
+            int j;
+
+            // a candidate can only be longer if it also matches at numBytes
+            if (src[i + numBytes] != src[pos + numBytes])
+                continue;
+
+            j = mf->matchLength(src + i, src + pos, end);
+            if (j > numBytes)
+            {
+                numBytes = j;
+                matchPos = i;
+
+                if (j == end)
+                    break;
+            }
         }
     }
 
@@ -116,123 +421,572 @@ static uint32_t simpleEnc(uint8_t *src, int size, int pos, uint32_t *pMatchPos)
     return numBytes;
 }
 
+// longest match at pos, from the table filled by findAllMatches if there is one
+static uint32_t findMatch(yaz0_encoder *enc, uint8_t *src, int size, int pos, uint32_t *pMatchPos)
+{
+    if (pos < enc->matchCount)
+    {
+        *pMatchPos = enc->matchPos[pos];
+        return enc->matchLen[pos];
+    }
+
+    return simpleEnc(enc->mf, src, size, pos, pMatchPos);
+}
+
 // a lookahead encoding scheme for ngc Yaz0
-static uint32_t nintendoEnc(uint8_t *src, int size, int pos, uint32_t *pMatchPos)
+static uint32_t nintendoEnc(yaz0_encoder *enc, uint8_t *src, int size, int pos, uint32_t *pMatchPos)
 {
     uint32_t numBytes = 1;
-    static uint32_t numBytes1;
-    static uint32_t matchPos;
-    static int prevFlag = 0;
 
-    // if prevFlag is set, it means that the previous position
+    // if lookaheadPending is set, it means that the previous position
     // was determined by look-ahead try.
     // so just use it. this is not the best optimization,
     // but nintendo's choice for speed.
-    if (prevFlag == 1)
+    if (enc->lookaheadPending)
     {
-        *pMatchPos = matchPos;
-        prevFlag = 0;
-        return numBytes1;
+        *pMatchPos = enc->lookaheadMatchPos;
+        enc->lookaheadPending = 0;
+        return enc->lookaheadNumBytes;
     }
 
-    prevFlag = 0;
-    numBytes = simpleEnc(src, size, pos, &matchPos);
-    *pMatchPos = matchPos;
+    numBytes = findMatch(enc, src, size, pos, pMatchPos);
 
     // if this position is RLE encoded, then compare to copying 1 byte and next position(pos+1) encoding
     if (numBytes >= 3)
     {
-        numBytes1 = simpleEnc(src, size, pos + 1, &matchPos);
+        enc->lookaheadNumBytes = findMatch(enc, src, size, pos + 1, &enc->lookaheadMatchPos);
         // if the next position encoding is +2 longer than current position, choose it.
         // this does not guarantee the best optimization, but fairly good optimization with speed.
-        if (numBytes1 >= numBytes + 2)
+        if (enc->lookaheadNumBytes >= numBytes + 2)
         {
             numBytes = 1;
-            prevFlag = 1;
+            enc->lookaheadPending = 1;
         }
     }
     return numBytes;
 }
 
-int yaz0_encode(uint8_t *src, uint8_t *dst, int srcSize)
+// output side of the encoder: collects up to eight codes and writes them
+// out behind their "code" byte, either into dst or to a sink
+typedef struct code_writer
 {
-    int srcPos = 0;
-    int dstPos = 0;
-    int bufPos = 0;
+    uint8_t *dst;
+    int dstPos;
 
-    uint8_t buf[24]; // 8 codes * 3 bytes maximum
+    yaz0_sink sink;
+    void *userData;
 
-    uint32_t validBitCount = 0; // number of valid bits left in "code" byte
-    uint8_t currCodeByte = 0; // a bitfield, set bits meaning copy, unset meaning RLE
+    uint8_t group[1 + 24]; // "code" byte + 8 codes * 3 bytes maximum
+    int groupPos;
 
-    while (srcPos < srcSize)
+    uint32_t validBitCount; // number of codes in group
+} code_writer;
+
+static void writerInit(code_writer *w, uint8_t *dst, yaz0_sink sink, void *userData)
+{
+    w->dst = dst;
+    w->dstPos = 0;
+    w->sink = sink;
+    w->userData = userData;
+    w->group[0] = 0;
+    w->groupPos = 1;
+    w->validBitCount = 0;
+}
+
+static void writerFlush(code_writer *w)
+{
+    if (w->validBitCount == 0)
+        return;
+
+    if (w->sink != NULL)
+        w->sink(w->userData, w->group, w->groupPos);
+    else
+        memcpy(w->dst + w->dstPos, w->group, w->groupPos);
+    w->dstPos += w->groupPos;
+
+    w->group[0] = 0;
+    w->groupPos = 1;
+    w->validBitCount = 0;
+}
+
+static void writerNextCode(code_writer *w)
+{
+    w->validBitCount++;
+
+    // write eight codes
+    if (w->validBitCount == 8)
+        writerFlush(w);
+}
+
+static void writerLiteral(code_writer *w, uint8_t value)
+{
+    // straight copy
+    w->group[w->groupPos++] = value;
+    //set flag for straight copy
+    w->group[0] |= (0x80 >> w->validBitCount);
+    writerNextCode(w);
+}
+
+static void writerMatch(code_writer *w, uint32_t dist, uint32_t numBytes)
+{
+    //RLE part
+    if (numBytes >= 0x12)  // 3 byte encoding
     {
-        uint32_t numBytes;
-        uint32_t matchPos;
+        w->group[w->groupPos++] = 0 | (dist >> 8);
+        w->group[w->groupPos++] = dist & 0xFF;
+        w->group[w->groupPos++] = numBytes - 0x12;
+    }
+    else  // 2 byte encoding
+    {
+        w->group[w->groupPos++] = ((numBytes - 2) << 4) | (dist >> 8);
+        w->group[w->groupPos++] = dist & 0xFF;
+    }
+    writerNextCode(w);
+}
 
-        numBytes = nintendoEnc(src, srcSize, srcPos, &matchPos);
-        if (numBytes < 3)
-        {
-            // straight copy
-            buf[bufPos] = src[srcPos];
-            bufPos++;
-            srcPos++;
-            //set flag for straight copy
-            currCodeByte |= (0x80 >> validBitCount);
-        }
-        else
+// encoded size of one code, excluding its bit in the "code" byte
+static uint32_t codeSize(uint32_t numBytes, uint32_t longCodeMin)
+{
+    if (numBytes < 3)
+        return 1;
+    if (numBytes < longCodeMin)
+        return 2;
+    return 3;
+}
+
+// only counts the encoded size, one unit per byte
+static const yaz0_cost_model sizeCostModel = { 0, 0, 0, 0, 1 };
+
+// rough figures for a MIPS decoder loop like the ones in N64 games. the byte
+// weight is what DMAing one byte from ROM at about 5 MB/s costs at 93.75 MHz
+const yaz0_cost_model yaz0_default_cost_model = {
+    .literal = 10,
+    .shortMatch = 22,
+    .longMatch = 26,
+    .copiedByte = 5,
+    .byteWeight = 19,
+};
+
+// costs are only needed up to the longest match ahead, so they live in a ring.
+// its size is a power of two above MAX_RUNLEN, so positions wrap with a mask
+#define COST_RING 512
+#define COST_MASK (COST_RING - 1)
+
+// shortest path over all possible encodings of src[start..end).
+// since every match of length n also contains the matches shorter than n at
+// the same distance, the longest match at each position is enough to know
+// every encoding that can start there. the cost is tracked separately for
+// each number of codes modulo 8, so the "code" bytes are counted exactly.
+// the optimal level minimises the size, the decode cost level the weighted
+// size plus the decode cycles of enc->costModel. long matches only try a
+// few of their lengths, see NICE_MATCH
+static void optimalParse(yaz0_encoder *enc, uint8_t *src, int start, int end, code_writer *w)
+{
+    const yaz0_cost_model *model = enc->level == YAZ0_LEVEL_DECODE_COST ? &enc->costModel : &sizeCostModel;
+    size_t count = end - start + 1;
+    size_t needed = count * (sizeof(uint32_t) + sizeof(uint16_t[8]) + sizeof(uint16_t));
+
+    // the scratch memory only ever grows, so an encoder reused for assets of
+    // similar size doesn't allocate again
+    if (enc->scratchSize < needed)
+    {
+        free(enc->scratch);
+        enc->scratch = malloc(needed);
+        assert(enc->scratch != NULL);
+        enc->scratchSize = needed;
+    }
+
+    // largest elements first to keep every array aligned
+    uint32_t *matchPos = enc->scratch;
+    uint16_t (*step)[8] = (uint16_t (*)[8])(matchPos + count);
+    uint16_t *numBytes = (uint16_t *)(step + count);
+
+    uint64_t cost[COST_RING][8];
+    uint64_t matchCost[MAX_RUNLEN + 1];
+    uint32_t longCodeMin = enc->longCodeMin;
+    uint64_t literalCost = (uint64_t)model->byteWeight * codeSize(1, longCodeMin) + model->literal;
+
+    for (uint32_t n = 3; n <= MAX_RUNLEN; n++)
+    {
+        matchCost[n] = (uint64_t)model->byteWeight * codeSize(n, longCodeMin) + (uint64_t)model->copiedByte * n;
+        matchCost[n] += n < longCodeMin ? model->shortMatch : model->longMatch;
+    }
+
+    int size = end - start;
+
+    for (int i = 0; i < COST_RING; i++)
+    {
+        for (int k = 0; k < 8; k++)
+            cost[i][k] = UINT64_MAX;
+    }
+    // the writer may be in the middle of a group already
+    cost[0][w->validBitCount] = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        uint64_t *here = cost[i & COST_MASK];
+
+        numBytes[i] = findMatch(enc, src, end, start + i, &matchPos[i]);
+        int longMatch = numBytes[i] >= NICE_MATCH;
+
+        for (int k = 0; k < 8; k++)
         {
-            //RLE part
-            uint32_t dist = srcPos - matchPos - 1;
-            uint8_t byte1, byte2, byte3;
+            uint64_t base = here[k];
+            int next = (k + 1) & 7;
+
+            if (base == UINT64_MAX)
+                continue;
 
-            if (numBytes >= 0x12)  // 3 byte encoding
+            // a new "code" byte starts every eight codes
+            if (k == 0)
+                base += model->byteWeight;
+
+            if (base + literalCost < cost[(i + 1) & COST_MASK][next])
             {
-                byte1 = 0 | (dist >> 8);
-                byte2 = dist & 0xFF;
-                buf[bufPos++] = byte1;
-                buf[bufPos++] = byte2;
-                // maximum runlength for 3 byte encoding
-                if (numBytes > MAX_RUNLEN)
-                    numBytes = MAX_RUNLEN;
-                byte3 = numBytes - 0x12;
-                buf[bufPos++] = byte3;
+                cost[(i + 1) & COST_MASK][next] = base + literalCost;
+                step[i + 1][next] = 1;
             }
-            else  // 2 byte encoding
+
+            for (uint32_t n = longMatch ? longCodeMin - 1 : 3; n <= numBytes[i]; n++)
             {
-                byte1 = ((numBytes - 2) << 4) | (dist >> 8);
-                byte2 = dist & 0xFF;
-                buf[bufPos++] = byte1;
-                buf[bufPos++] = byte2;
+                uint64_t c;
+
+                // past the boundary between 2 and 3 byte codes, go straight to the whole match
+                if (longMatch && n == longCodeMin + 1)
+                    n = numBytes[i];
+
+                c = base + matchCost[n];
+                if (c < cost[(i + n) & COST_MASK][next])
+                {
+                    cost[(i + n) & COST_MASK][next] = c;
+                    step[i + n][next] = n;
+                }
             }
-            srcPos += numBytes;
         }
 
-        validBitCount++;
+        // nothing reaches this position anymore, the row is reused for i + COST_RING
+        for (int k = 0; k < 8; k++)
+            here[k] = UINT64_MAX;
+    }
+
+    uint64_t *last = cost[size & COST_MASK];
+    int best = 0;
+    for (int k = 1; k < 8; k++)
+    {
+        if (last[k] < last[best])
+            best = k;
+    }
 
-        // write eight codes
-        if (validBitCount == 8)
+    // walk the path backwards, storing each code length at its start position
+    int i = size;
+    int k = best;
+    while (i > 0)
+    {
+        uint16_t n = step[i][k];
+
+        i -= n;
+        k = (k + 7) & 7;
+        numBytes[i] = n;
+    }
+
+    while (i < size)
+    {
+        if (numBytes[i] < 3)
         {
-            dst[dstPos++] = currCodeByte;
-            for (int j = 0; j < bufPos; j++)
-                dst[dstPos++] = buf[j];
+            writerLiteral(w, src[start + i]);
+            i++;
+        }
+        else
+        {
+            writerMatch(w, start + i - matchPos[i] - 1, numBytes[i]);
+            i += numBytes[i];
+        }
+    }
+}
 
-            currCodeByte = 0;
-            validBitCount = 0;
-            bufPos = 0;
+// encode the codes starting in src[pos..end). matches may extend up to size.
+// returns the position after the last code
+static int encodeRange(yaz0_encoder *enc, uint8_t *src, int size, int pos, int end, code_writer *w)
+{
+    if (enc->level == YAZ0_LEVEL_OPTIMAL || enc->level == YAZ0_LEVEL_DECODE_COST)
+    {
+        optimalParse(enc, src, pos, end, w);
+        return end;
+    }
+
+    while (pos < end)
+    {
+        uint32_t numBytes;
+        uint32_t matchPos;
+
+        if (enc->level == YAZ0_LEVEL_FAST)
+            numBytes = findMatch(enc, src, size, pos, &matchPos);
+        else
+            numBytes = nintendoEnc(enc, src, size, pos, &matchPos);
+
+        if (numBytes < 3)
+        {
+            writerLiteral(w, src[pos]);
+            pos++;
         }
+        else
+        {
+            writerMatch(w, pos - matchPos - 1, numBytes);
+            pos += numBytes;
+        }
+    }
+
+    return pos;
+}
+
+// parallel match finding
+
+// inputs smaller than this aren't worth starting threads for
+#define PARALLEL_MIN_SIZE 0x40000
+
+typedef struct match_segment
+{
+    yaz0_encoder *enc;
+    uint8_t *src;
+    int size;
+    int start;
+    int end;
+} match_segment;
+
+// the result of simpleEnc at a position only depends on the window before it,
+// so a segment primed with the window of its first position finds exactly
+// the matches a single match finder would
+static void *findSegmentMatches(void *arg)
+{
+    match_segment *seg = arg;
+    yaz0_encoder *enc = seg->enc;
+    match_finder *mf = malloc(sizeof(match_finder));
+    assert(mf != NULL);
+
+    matchFinderInit(mf, enc->maxChain, enc->maxMatch);
+    mf->nextInsert = seg->start > WINDOW_SIZE ? seg->start - WINDOW_SIZE : 0;
+
+    for (int pos = seg->start; pos < seg->end; pos++)
+        enc->matchLen[pos] = simpleEnc(mf, seg->src, seg->size, pos, &enc->matchPos[pos]);
+
+    free(mf);
+    return NULL;
+}
+
+// fill the match table of the encoder for every position of src, using enc->threads threads
+static void findAllMatches(yaz0_encoder *enc, uint8_t *src, int srcSize)
+{
+    int threads = enc->threads;
+    match_segment seg[YAZ0_MAX_THREADS];
+    pthread_t thread[YAZ0_MAX_THREADS];
+    int started[YAZ0_MAX_THREADS] = { 0 };
+
+    if (threads > YAZ0_MAX_THREADS)
+        threads = YAZ0_MAX_THREADS;
+
+    if (enc->matchCapacity < srcSize)
+    {
+        free(enc->matchPos);
+        free(enc->matchLen);
+        enc->matchPos = malloc(srcSize * sizeof(uint32_t));
+        enc->matchLen = malloc(srcSize * sizeof(uint16_t));
+        assert(enc->matchPos != NULL && enc->matchLen != NULL);
+        enc->matchCapacity = srcSize;
     }
 
-    if (validBitCount > 0)
+    for (int t = 0; t < threads; t++)
     {
-        dst[dstPos++] = currCodeByte;
-        for (int j = 0; j < bufPos; j++)
-            dst[dstPos++] = buf[j];
+        seg[t].enc = enc;
+        seg[t].src = src;
+        seg[t].size = srcSize;
+        seg[t].start = (int)((int64_t)srcSize * t / threads);
+        seg[t].end = (int)((int64_t)srcSize * (t + 1) / threads);
+    }
 
-        currCodeByte = 0;
-        validBitCount = 0;
-        bufPos = 0;
+    // the calling thread takes the first segment itself
+    for (int t = 1; t < threads; t++)
+        started[t] = pthread_create(&thread[t], NULL, findSegmentMatches, &seg[t]) == 0;
+
+    findSegmentMatches(&seg[0]);
+
+    for (int t = 1; t < threads; t++)
+    {
+        if (started[t])
+            pthread_join(thread[t], NULL);
+        else
+            findSegmentMatches(&seg[t]);
     }
 
-    return dstPos;
+    enc->matchCount = srcSize;
+}
+
+void yaz0_encoder_init(yaz0_encoder *enc, yaz0_level level, int maxChain)
+{
+    enc->level = level;
+    enc->maxChain = maxChain;
+    enc->threads = 1;
+    enc->maxMatch = YAZ0_MAX_MATCH;
+    enc->longCodeMin = 0x12;
+    enc->costModel = yaz0_default_cost_model;
+
+    enc->mf = malloc(sizeof(match_finder));
+    assert(enc->mf != NULL);
+
+    enc->lookaheadNumBytes = 0;
+    enc->lookaheadMatchPos = 0;
+    enc->lookaheadPending = 0;
+
+    enc->scratch = NULL;
+    enc->scratchSize = 0;
+
+    enc->matchPos = NULL;
+    enc->matchLen = NULL;
+    enc->matchCount = 0;
+    enc->matchCapacity = 0;
+}
+
+size_t yaz0_encoder_memory(const yaz0_encoder *enc)
+{
+    return sizeof(match_finder) + enc->scratchSize + (size_t)enc->matchCapacity * (sizeof(uint32_t) + sizeof(uint16_t));
+}
+
+void yaz0_encoder_destroy(yaz0_encoder *enc)
+{
+    free(enc->matchPos);
+    free(enc->matchLen);
+    enc->matchPos = NULL;
+    enc->matchLen = NULL;
+    enc->matchCount = 0;
+    enc->matchCapacity = 0;
+
+    free(enc->scratch);
+    enc->scratch = NULL;
+    enc->scratchSize = 0;
+
+    free(enc->mf);
+    enc->mf = NULL;
+}
+
+static void encoderReset(yaz0_encoder *enc)
+{
+    // nothing carries over from the previous buffer
+    matchFinderInit(enc->mf, enc->maxChain, enc->maxMatch);
+    enc->lookaheadPending = 0;
+    enc->matchCount = 0;
+}
+
+int yaz0_encoder_encode(yaz0_encoder *enc, uint8_t *src, uint8_t *dst, int srcSize)
+{
+    code_writer w;
+
+    writerInit(&w, dst, NULL, NULL);
+    encoderReset(enc);
+
+    if (enc->threads > 1 && srcSize >= PARALLEL_MIN_SIZE)
+        findAllMatches(enc, src, srcSize);
+
+    encodeRange(enc, src, srcSize, 0, srcSize, &w);
+    writerFlush(&w);
+
+    enc->matchCount = 0;
+
+    return w.dstPos;
+}
+
+int yaz0_encode(uint8_t *src, uint8_t *dst, int srcSize, yaz0_level level, int maxChain)
+{
+    yaz0_encoder enc;
+
+    yaz0_encoder_init(&enc, level, maxChain);
+    int dstSize = yaz0_encoder_encode(&enc, src, dst, srcSize);
+    yaz0_encoder_destroy(&enc);
+
+    return dstSize;
+}
+
+// streaming
+
+// bytes the stream keeps after the current position. the lookahead level
+// reads up to MAX_RUNLEN bytes starting one position ahead, so with this much
+// data buffered the codes are exactly the ones yaz0_encode would produce
+#define STREAM_LOOKAHEAD (MAX_RUNLEN + 1)
+// bytes encoded between two slides of the buffer
+#define STREAM_CHUNK 0x4000
+#define STREAM_BUFFER_SIZE (WINDOW_SIZE + STREAM_CHUNK + STREAM_LOOKAHEAD)
+
+void yaz0_stream_init(yaz0_stream *stream, yaz0_encoder *enc, yaz0_sink sink, void *userData)
+{
+    stream->enc = enc;
+    encoderReset(enc);
+
+    stream->buffer = malloc(STREAM_BUFFER_SIZE);
+    assert(stream->buffer != NULL);
+    stream->fill = 0;
+    stream->pos = 0;
+
+    stream->writer = malloc(sizeof(code_writer));
+    assert(stream->writer != NULL);
+    writerInit(stream->writer, NULL, sink, userData);
+
+    stream->totalIn = 0;
+}
+
+void yaz0_stream_destroy(yaz0_stream *stream)
+{
+    free(stream->writer);
+    stream->writer = NULL;
+
+    free(stream->buffer);
+    stream->buffer = NULL;
+}
+
+// drop everything before the window of the current position
+static void streamSlide(yaz0_stream *stream)
+{
+    int shift = (stream->pos - WINDOW_SIZE) & ~WINDOW_MASK;
+
+    if (shift <= 0)
+        return;
+
+    memmove(stream->buffer, stream->buffer + shift, stream->fill - shift);
+    stream->fill -= shift;
+    stream->pos -= shift;
+
+    matchFinderSlide(stream->enc->mf, shift);
+    stream->enc->lookaheadMatchPos -= shift;
+}
+
+void yaz0_stream_write(yaz0_stream *stream, const uint8_t *data, int size)
+{
+    stream->totalIn += size;
+
+    while (size > 0)
+    {
+        int copy = STREAM_BUFFER_SIZE - stream->fill;
+        if (copy > size)
+            copy = size;
+
+        memcpy(stream->buffer + stream->fill, data, copy);
+        stream->fill += copy;
+        data += copy;
+        size -= copy;
+
+        if (stream->fill == STREAM_BUFFER_SIZE)
+        {
+            int end = stream->fill - STREAM_LOOKAHEAD;
+
+            if (stream->pos < end)
+                stream->pos = encodeRange(stream->enc, stream->buffer, stream->fill, stream->pos, end, stream->writer);
+            streamSlide(stream);
+        }
+    }
+}
+
+int yaz0_stream_finish(yaz0_stream *stream)
+{
+    if (stream->pos < stream->fill)
+        stream->pos = encodeRange(stream->enc, stream->buffer, stream->fill, stream->pos, stream->fill, stream->writer);
+    writerFlush(stream->writer);
+
+    return stream->writer->dstPos;
 }
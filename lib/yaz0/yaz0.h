@@ -1,8 +1,116 @@
 #ifndef _YAZ0_H_
 #define _YAZ0_H_
 
-void yaz0_decode(uint8_t* src, uint8_t* dst, int uncompressedSize);
+#include <stddef.h>
+#include <stdint.h>
 
-int yaz0_encode(uint8_t *src, uint8_t *dest, int srcSize);
+// number of hash chain candidates yaz0_encode examines per position by default.
+// this covers the whole 0x1000 byte window, so it always finds the longest match
+#define YAZ0_DEFAULT_MAX_CHAIN 0x1000
+
+// longest match a yaz0 code can hold
+#define YAZ0_MAX_MATCH (0xFF + 0x12)
+
+// upper limit for yaz0_encoder.threads
+#define YAZ0_MAX_THREADS 64
+
+typedef enum yaz0_level
+{
+    YAZ0_LEVEL_FAST,        // greedy, always takes the longest match
+    YAZ0_LEVEL_NINTENDO,    // one step lookahead, the same choices nintendo's encoder makes
+    YAZ0_LEVEL_OPTIMAL,     // smallest possible output for the matches found
+    YAZ0_LEVEL_DECODE_COST, // like optimal, but weighs the size against the cost of decoding it
+} yaz0_level;
+
+// estimated cycles the target's decoder spends on each kind of code, and how
+// many cycles one byte of compressed data is worth (e.g. the time to load it)
+typedef struct yaz0_cost_model
+{
+    uint32_t literal;    // straight copy code
+    uint32_t shortMatch; // 2 byte RLE code
+    uint32_t longMatch;  // 3 byte RLE code
+    uint32_t copiedByte; // every byte a RLE code copies
+    uint32_t byteWeight;
+} yaz0_cost_model;
+
+extern const yaz0_cost_model yaz0_default_cost_model;
+
+// all the state of one encoder. an encoder can be reused for any number of
+// buffers and keeps its memory between them, but it must only be used by one
+// thread at a time
+typedef struct yaz0_encoder
+{
+    yaz0_level level;
+    int maxChain;
+    // number of threads searching matches in big inputs. 1 after init, can be
+    // changed before encoding. the output is the same for any number of threads
+    int threads;
+    // longest match to use, YAZ0_MAX_MATCH after init. lowered by formats
+    // like mio0 that can't code long matches
+    int maxMatch;
+    // shortest match taking a 3 byte code, 0x12 after init. the optimal and
+    // cost levels count code sizes with it. raised by formats like mio0 whose
+    // links all take 2 bytes
+    int longCodeMin;
+    // YAZ0_LEVEL_DECODE_COST: yaz0_default_cost_model after init, can be changed before encoding
+    yaz0_cost_model costModel;
+
+    struct match_finder *mf;
+
+    // YAZ0_LEVEL_NINTENDO: the match found by the last look-ahead try
+    uint32_t lookaheadNumBytes;
+    uint32_t lookaheadMatchPos;
+    int lookaheadPending;
+
+    // YAZ0_LEVEL_OPTIMAL and YAZ0_LEVEL_DECODE_COST: per position parse state
+    void *scratch;
+    size_t scratchSize;
+
+    // longest match at every position, when they were searched in parallel
+    uint32_t *matchPos;
+    uint16_t *matchLen;
+    int matchCount; // 0 if the matches are searched while encoding
+    int matchCapacity;
+} yaz0_encoder;
+
+int yaz0_decode(const uint8_t* src, int srcSize, uint8_t* dst, int uncompressedSize);
+// estimated cycles to decode a stream (without header) according to model
+uint64_t yaz0_decode_cost(const uint8_t* src, int srcSize, int uncompressedSize, const yaz0_cost_model* model);
+
+void yaz0_encoder_init(yaz0_encoder *enc, yaz0_level level, int maxChain);
+void yaz0_encoder_destroy(yaz0_encoder *enc);
+int yaz0_encoder_encode(yaz0_encoder *enc, uint8_t *src, uint8_t *dest, int srcSize);
+// bytes of heap memory the encoder keeps between buffers. the match search
+// threads each use one more match finder while they run
+size_t yaz0_encoder_memory(const yaz0_encoder *enc);
+
+// one-shot version of the above
+int yaz0_encode(uint8_t *src, uint8_t *dest, int srcSize, yaz0_level level, int maxChain);
+
+// receives the compressed data of a stream, one group of up to eight codes at a time
+typedef void (*yaz0_sink)(void *userData, const uint8_t *data, int size);
+
+// streaming encoder: takes the input in chunks of any size and only keeps the
+// window, the current chunk and the lookahead in memory. the fast and nintendo
+// levels produce the same data as yaz0_encode; the optimal level is optimal
+// per chunk. the Yaz0 header is left to the caller
+typedef struct yaz0_stream
+{
+    yaz0_encoder *enc;
+
+    uint8_t *buffer;
+    int fill; // bytes of input in buffer
+    int pos;  // next position of buffer to encode
+
+    struct code_writer *writer;
+
+    uint32_t totalIn; // bytes written to the stream so far
+} yaz0_stream;
+
+void yaz0_stream_init(yaz0_stream *stream, yaz0_encoder *enc, yaz0_sink sink, void *userData);
+void yaz0_stream_destroy(yaz0_stream *stream);
+void yaz0_stream_write(yaz0_stream *stream, const uint8_t *data, int size);
+// encodes whatever is left, returns the total compressed size
+int yaz0_stream_finish(yaz0_stream *stream);
 
 #endif  // _YAZ0_H_
@@ -1,5 +1,11 @@
 #include "bit_convert.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 int8_t ToInt8BE(const uint8_t* data, int32_t offset) {
     return (uint8_t)data[offset + 0];
 }
@@ -46,3 +52,106 @@ void FromUInt32ToBE(uint8_t* data, int32_t offset, uint32_t value) {
     data[offset + 2] = (uint8_t)(value >> 8);
     data[offset + 3] = (uint8_t)(value >> 0);
 }
+
+/* Bulk byte swaps, reversing the bytes of each of count elements in place. 16 bytes at a time with SSE2 or NEON */
+
+void SwapUInt16Array(uint8_t* data, size_t count) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i * 2));
+
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i*)(data + i * 2), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(data + i * 2, vrev16q_u8(vld1q_u8(data + i * 2)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint8_t* p = data + i * 2;
+        uint8_t b = p[0];
+
+        p[0] = p[1];
+        p[1] = b;
+    }
+}
+
+void SwapUInt32Array(uint8_t* data, size_t count) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i * 4));
+
+        // swap the bytes of each halfword, then the halfwords of each word
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i*)(data + i * 4), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u8(data + i * 4, vrev32q_u8(vld1q_u8(data + i * 4)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint8_t* p = data + i * 4;
+        uint32_t value = ToUInt32BE(p, 0);
+
+        p[0] = (uint8_t)(value >> 0);
+        p[1] = (uint8_t)(value >> 8);
+        p[2] = (uint8_t)(value >> 16);
+        p[3] = (uint8_t)(value >> 24);
+    }
+}
+
+void SwapUInt64Array(uint8_t* data, size_t count) {
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    for (; i + 2 <= count; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i * 8));
+
+        // swap the bytes of each halfword, then reverse the halfwords of each doubleword
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i*)(data + i * 8), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 2 <= count; i += 2) {
+        vst1q_u8(data + i * 8, vrev64q_u8(vld1q_u8(data + i * 8)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        uint8_t* p = data + i * 8;
+        uint64_t value = ToUInt64BE(p, 0);
+
+        for (int j = 0; j < 8; j++) {
+            p[j] = (uint8_t)(value >> (j * 8));
+        }
+    }
+}
+
+void SwapArrayElements(uint8_t* data, size_t count, size_t elementSize) {
+    switch (elementSize) {
+        case 2:
+            SwapUInt16Array(data, count);
+            break;
+
+        case 4:
+            SwapUInt32Array(data, count);
+            break;
+
+        case 8:
+            SwapUInt64Array(data, count);
+            break;
+
+        default:
+            break;
+    }
+}
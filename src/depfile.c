@@ -0,0 +1,66 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "depfile.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TOOL_PATH_MAX 4096
+
+// escapes the characters make treats specially the same way gcc does: spaces and # with a backslash, $ doubled
+static void Depfile_WritePath(FILE* outFile, const char* path) {
+    for (const char* c = path; *c != '\0'; c++) {
+        switch (*c) {
+            case ' ':
+            case '\t':
+            case '#':
+                fputc('\\', outFile);
+                break;
+
+            case '$':
+                fputc('$', outFile);
+                break;
+
+            default:
+                break;
+        }
+        fputc(*c, outFile);
+    }
+}
+
+void Depfile_Write(FILE* outFile, const char* const* targets, size_t targetCount, const char* const* prerequisites,
+                   size_t prerequisiteCount) {
+    assert(targetCount != 0);
+
+    for (size_t i = 0; i < targetCount; i++) {
+        if (i != 0) {
+            fputc(' ', outFile);
+        }
+        Depfile_WritePath(outFile, targets[i]);
+    }
+    fputc(':', outFile);
+
+    for (size_t i = 0; i < prerequisiteCount; i++) {
+        fprintf(outFile, " \\\n ");
+        Depfile_WritePath(outFile, prerequisites[i]);
+    }
+    fputc('\n', outFile);
+}
+
+// the running binary, so rebuilding texture2c reconverts everything. argv[0] if the system can't tell
+char* Depfile_GetToolPath(const char* argv0) {
+    char* path = malloc(TOOL_PATH_MAX);
+    assert(path != NULL);
+
+    ssize_t length = readlink("/proc/self/exe", path, TOOL_PATH_MAX - 1);
+
+    if (length > 0) {
+        path[length] = '\0';
+    } else {
+        strncpy(path, argv0, TOOL_PATH_MAX - 1);
+        path[TOOL_PATH_MAX - 1] = '\0';
+    }
+    return path;
+}
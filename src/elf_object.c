@@ -0,0 +1,269 @@
+#include "elf_object.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "bit_convert.h"
+
+// only the parts of the ELF format a relocatable object with one data section needs
+
+#define EM_MIPS 8
+#define EM_386 3
+#define EM_X86_64 62
+#define EM_AARCH64 183
+
+#define ET_REL 1
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+
+#define SHF_WRITE 0x1
+#define SHF_ALLOC 0x2
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_OBJECT 1
+#define STT_SECTION 3
+
+#define SHN_ABS 0xFFF1
+
+// mips3, o32, the same as objects built for the N64 have
+#define EF_MIPS_ARCH_3 0x20000000
+#define EF_MIPS_ABI_O32 0x00001000
+
+typedef struct ElfLayout {
+    bool is64;
+    bool bigEndian;
+    uint16_t machine;
+    uint32_t flags;
+    bool noteGnuStack; // tells the linker the data doesn't need an executable stack
+} ElfLayout;
+
+enum {
+    SECTION_NULL,
+    SECTION_DATA,
+    SECTION_SYMTAB,
+    SECTION_STRTAB,
+    SECTION_SHSTRTAB,
+    SECTION_GNU_STACK, // only if noteGnuStack
+};
+
+static bool ElfObject_GetLayout(ElfLayout* layout, ElfTarget target) {
+    if (target == ElfTarget_Mips) {
+        layout->is64 = false;
+        layout->bigEndian = true;
+        layout->machine = EM_MIPS;
+        layout->flags = EF_MIPS_ARCH_3 | EF_MIPS_ABI_O32;
+        layout->noteGnuStack = false;
+        return true;
+    }
+
+    layout->is64 = sizeof(void*) == 8;
+    layout->bigEndian = false;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    layout->bigEndian = true;
+#endif
+    layout->flags = 0;
+    layout->noteGnuStack = true;
+
+#if defined(__x86_64__)
+    layout->machine = EM_X86_64;
+#elif defined(__i386__)
+    layout->machine = EM_386;
+#elif defined(__aarch64__)
+    layout->machine = EM_AARCH64;
+#else
+    fprintf(stderr, "Error: ELF output for this host is not supported\n");
+    return false;
+#endif
+    return true;
+}
+
+static void ElfObject_Put(uint8_t* out, size_t offset, uint64_t value, size_t size, bool bigEndian) {
+    for (size_t i = 0; i < size; i++) {
+        size_t shift = 8 * (bigEndian ? size - 1 - i : i);
+
+        out[offset + i] = (uint8_t)(value >> shift);
+    }
+}
+
+static size_t ElfObject_Align(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// writes entry index of the symbol table at symOffset
+static void ElfObject_PutSymbol(uint8_t* out, const ElfLayout* layout, size_t symOffset, size_t index, uint32_t name,
+                                uint64_t value, uint64_t size, uint8_t info, uint16_t shndx) {
+    bool be = layout->bigEndian;
+
+    if (layout->is64) {
+        size_t o = symOffset + index * 24;
+
+        ElfObject_Put(out, o + 0, name, 4, be);
+        out[o + 4] = info;
+        ElfObject_Put(out, o + 6, shndx, 2, be);
+        ElfObject_Put(out, o + 8, value, 8, be);
+        ElfObject_Put(out, o + 16, size, 8, be);
+    } else {
+        size_t o = symOffset + index * 16;
+
+        ElfObject_Put(out, o + 0, name, 4, be);
+        ElfObject_Put(out, o + 4, value, 4, be);
+        ElfObject_Put(out, o + 8, size, 4, be);
+        out[o + 12] = info;
+        ElfObject_Put(out, o + 14, shndx, 2, be);
+    }
+}
+
+static void ElfObject_PutSection(uint8_t* out, const ElfLayout* layout, size_t shOffset, size_t index, uint32_t name,
+                                 uint32_t type, uint64_t flags, uint64_t offset, uint64_t size, uint32_t link,
+                                 uint32_t info, uint64_t alignment, uint64_t entrySize) {
+    bool be = layout->bigEndian;
+    size_t w = layout->is64 ? 8 : 4;
+    size_t o = shOffset + index * (layout->is64 ? 64 : 40);
+
+    ElfObject_Put(out, o, name, 4, be);
+    o += 4;
+    ElfObject_Put(out, o, type, 4, be);
+    o += 4;
+    ElfObject_Put(out, o, flags, w, be);
+    o += 2 * w; // sh_addr is 0
+    ElfObject_Put(out, o, offset, w, be);
+    o += w;
+    ElfObject_Put(out, o, size, w, be);
+    o += w;
+    ElfObject_Put(out, o, link, 4, be);
+    o += 4;
+    ElfObject_Put(out, o, info, 4, be);
+    o += 4;
+    ElfObject_Put(out, o, alignment, w, be);
+    o += w;
+    ElfObject_Put(out, o, entrySize, w, be);
+}
+
+/**
+ * Writes a relocatable object holding the buffer in sectionName, with a global symbolName pointing at it and an
+ * absolute symbolName_size holding its size. The buffer is a sequence of big endian elements of elementSize bytes,
+ * which are stored in the target's byte order, so the data reads the same as a C array of them would.
+ */
+bool ElfObject_Write(const GenericBuffer* buffer, FILE* outFile, ElfTarget target, const char* sectionName,
+                     const char* symbolName, size_t elementSize, size_t alignment) {
+    assert(buffer->hasData);
+    assert(outFile != NULL);
+    assert(sectionName != NULL);
+    assert(symbolName != NULL);
+
+    ElfLayout layout;
+    if (!ElfObject_GetLayout(&layout, target)) {
+        return false;
+    }
+
+    bool be = layout.bigEndian;
+    size_t w = layout.is64 ? 8 : 4;
+    size_t dataSize = buffer->bufferLength;
+
+    if (alignment < 1) {
+        alignment = 1;
+    }
+
+    // "\0symbol\0symbol_size\0"
+    size_t symbolLength = strlen(symbolName);
+    size_t strtabSize = 1 + symbolLength + 1 + symbolLength + strlen("_size") + 1;
+    // "\0section\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack\0"
+    size_t sectionLength = strlen(sectionName);
+    size_t shstrtabSize = 1 + sectionLength + 1 + sizeof(".symtab") + sizeof(".strtab") + sizeof(".shstrtab") +
+                          sizeof(".note.GNU-stack");
+    size_t sectionCount = layout.noteGnuStack ? SECTION_GNU_STACK + 1 : SECTION_GNU_STACK;
+
+    size_t ehSize = layout.is64 ? 64 : 52;
+    size_t symEntrySize = layout.is64 ? 24 : 16;
+    size_t symCount = 4;
+    size_t shEntrySize = layout.is64 ? 64 : 40;
+
+    size_t dataOffset = ElfObject_Align(ehSize, alignment);
+    size_t symOffset = ElfObject_Align(dataOffset + dataSize, w);
+    size_t strtabOffset = symOffset + symCount * symEntrySize;
+    size_t shstrtabOffset = strtabOffset + strtabSize;
+    size_t shOffset = ElfObject_Align(shstrtabOffset + shstrtabSize, w);
+    size_t fileSize = shOffset + sectionCount * shEntrySize;
+
+    uint8_t* out = calloc(fileSize, sizeof(uint8_t));
+    assert(out != NULL);
+
+    /* ELF header */
+    memcpy(out, "\x7F" "ELF", 4);
+    out[4] = layout.is64 ? 2 : 1;
+    out[5] = be ? 2 : 1;
+    out[6] = 1; // EV_CURRENT
+    ElfObject_Put(out, 16, ET_REL, 2, be);
+    ElfObject_Put(out, 18, layout.machine, 2, be);
+    ElfObject_Put(out, 20, 1, 4, be);
+    // e_entry and e_phoff are 0
+    ElfObject_Put(out, 24 + 2 * w, shOffset, w, be);
+    ElfObject_Put(out, 24 + 3 * w, layout.flags, 4, be);
+    ElfObject_Put(out, 28 + 3 * w, ehSize, 2, be);
+    // e_phentsize and e_phnum are 0
+    ElfObject_Put(out, 34 + 3 * w, shEntrySize, 2, be);
+    ElfObject_Put(out, 36 + 3 * w, sectionCount, 2, be);
+    ElfObject_Put(out, 38 + 3 * w, SECTION_SHSTRTAB, 2, be);
+
+    /* Data, elements in target byte order. an incomplete last element keeps its bytes where they are */
+    memcpy(out + dataOffset, buffer->buffer, dataSize);
+    if (!be) {
+        SwapArrayElements(out + dataOffset, dataSize / elementSize, elementSize);
+    }
+
+    /* Symbols */
+    uint32_t symbolNameOffset = 1;
+    uint32_t sizeNameOffset = symbolNameOffset + symbolLength + 1;
+
+    ElfObject_PutSymbol(out, &layout, symOffset, 1, 0, 0, 0, (STB_LOCAL << 4) | STT_SECTION, SECTION_DATA);
+    ElfObject_PutSymbol(out, &layout, symOffset, 2, symbolNameOffset, 0, dataSize, (STB_GLOBAL << 4) | STT_OBJECT,
+                        SECTION_DATA);
+    ElfObject_PutSymbol(out, &layout, symOffset, 3, sizeNameOffset, dataSize, 0, (STB_GLOBAL << 4) | STT_NOTYPE,
+                        SHN_ABS);
+
+    memcpy(out + strtabOffset + symbolNameOffset, symbolName, symbolLength);
+    memcpy(out + strtabOffset + sizeNameOffset, symbolName, symbolLength);
+    memcpy(out + strtabOffset + sizeNameOffset + symbolLength, "_size", strlen("_size"));
+
+    /* Section names */
+    uint32_t dataName = 1;
+    uint32_t symtabName = dataName + sectionLength + 1;
+    uint32_t strtabName = symtabName + sizeof(".symtab");
+    uint32_t shstrtabName = strtabName + sizeof(".strtab");
+    uint32_t gnuStackName = shstrtabName + sizeof(".shstrtab");
+
+    memcpy(out + shstrtabOffset + dataName, sectionName, sectionLength);
+    memcpy(out + shstrtabOffset + symtabName, ".symtab", sizeof(".symtab"));
+    memcpy(out + shstrtabOffset + strtabName, ".strtab", sizeof(".strtab"));
+    memcpy(out + shstrtabOffset + shstrtabName, ".shstrtab", sizeof(".shstrtab"));
+    memcpy(out + shstrtabOffset + gnuStackName, ".note.GNU-stack", sizeof(".note.GNU-stack"));
+
+    /* Section headers */
+    uint64_t dataFlags = SHF_ALLOC;
+    if (strncmp(sectionName, ".data", strlen(".data")) == 0) {
+        dataFlags |= SHF_WRITE;
+    }
+
+    ElfObject_PutSection(out, &layout, shOffset, SECTION_DATA, dataName, SHT_PROGBITS, dataFlags, dataOffset, dataSize,
+                         0, 0, alignment, 0);
+    // sh_info is the index of the first global symbol
+    ElfObject_PutSection(out, &layout, shOffset, SECTION_SYMTAB, symtabName, SHT_SYMTAB, 0, symOffset,
+                         symCount * symEntrySize, SECTION_STRTAB, 2, w, symEntrySize);
+    ElfObject_PutSection(out, &layout, shOffset, SECTION_STRTAB, strtabName, SHT_STRTAB, 0, strtabOffset, strtabSize,
+                         0, 0, 1, 0);
+    ElfObject_PutSection(out, &layout, shOffset, SECTION_SHSTRTAB, shstrtabName, SHT_STRTAB, 0, shstrtabOffset,
+                         shstrtabSize, 0, 0, 1, 0);
+    if (layout.noteGnuStack) {
+        ElfObject_PutSection(out, &layout, shOffset, SECTION_GNU_STACK, gnuStackName, SHT_PROGBITS, 0, shOffset, 0, 0,
+                             0, 1, 0);
+    }
+
+    fwrite(out, sizeof(uint8_t), fileSize, outFile);
+    free(out);
+
+    return true;
+}
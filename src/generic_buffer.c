@@ -1,10 +1,13 @@
 #include "generic_buffer.h"
 
 #include <assert.h>
+#include <pthread.h>
 #include <string.h>
 #include <inttypes.h>
 
 #include "bit_convert.h"
+#include "mio0/mio0.h"
+#include "yay0/yay0.h"
 #include "yaz0/yaz0.h"
 #include "macros.h"
 
@@ -22,73 +25,333 @@ void GenericBuffer_Destroy(GenericBuffer* buffer) {
     }
 }
 
-void GenericBuffer_WriteAsRawCArray(GenericBuffer* buffer, TypeBitWidth bitWidth, FILE* outFile) {
-    assert(buffer->hasData);
-    assert(bitWidth >= 0 && bitWidth < TypeBitWidth_Max);
-    assert(outFile != NULL);
+/* C array output */
+
+#define HEX_DIGIT(n) ((n) < 10 ? '0' + (n) : 'A' + (n)-10)
+#define HEX_PAIR(n) { HEX_DIGIT((n) >> 4), HEX_DIGIT((n)&0xF) }
+#define HEX_ROW(n)                                                                                                   \
+    HEX_PAIR((n) + 0x0), HEX_PAIR((n) + 0x1), HEX_PAIR((n) + 0x2), HEX_PAIR((n) + 0x3), HEX_PAIR((n) + 0x4),         \
+        HEX_PAIR((n) + 0x5), HEX_PAIR((n) + 0x6), HEX_PAIR((n) + 0x7), HEX_PAIR((n) + 0x8), HEX_PAIR((n) + 0x9),     \
+        HEX_PAIR((n) + 0xA), HEX_PAIR((n) + 0xB), HEX_PAIR((n) + 0xC), HEX_PAIR((n) + 0xD), HEX_PAIR((n) + 0xE),     \
+        HEX_PAIR((n) + 0xF)
+
+// the two uppercase hex digits of every byte
+static const char sHexPairs[256][2] = {
+    HEX_ROW(0x00), HEX_ROW(0x10), HEX_ROW(0x20), HEX_ROW(0x30), HEX_ROW(0x40), HEX_ROW(0x50), HEX_ROW(0x60), HEX_ROW(0x70),
+    HEX_ROW(0x80), HEX_ROW(0x90), HEX_ROW(0xA0), HEX_ROW(0xB0), HEX_ROW(0xC0), HEX_ROW(0xD0), HEX_ROW(0xE0), HEX_ROW(0xF0),
+};
+
+// every line holds 32 bytes, whatever the element size
+#define HEX_LINE_BYTES 32
+// the longest line any style makes, 8 bit hex elements behind a designator
+#define HEX_LINE_MAX_CHARS (4 + 24 + HEX_LINE_BYTES * 6 + 1)
+// lines formatted before each fwrite, per thread
+#define HEX_BLOCK_LINES 0x2000
+// smaller buffers aren't worth starting threads for
+#define HEX_PARALLEL_MIN_SIZE 0x100000
+
+static const size_t sBitWidthBytes[TypeBitWidth_Max] = {
+    [TypeBitWidth_8] = 1,
+    [TypeBitWidth_16] = 2,
+    [TypeBitWidth_32] = 4,
+    [TypeBitWidth_64] = 8,
+};
+
+typedef struct HexFormatJob {
+    const uint8_t* data;
+    size_t length;
+    size_t step;
+    CArrayStyle style;
+    bool skipZeros;
+    size_t zeroTail; // start of the zero lines at the end
+    size_t start;    // line aligned
+    size_t end;
+    char* out;
+    size_t outLength;
+} HexFormatJob;
+
+static const uint8_t sZeroLine[HEX_LINE_BYTES] = { 0 };
+
+static bool GenericBuffer_IsZeroLine(const HexFormatJob* job, size_t line) {
+    size_t lineEnd = line + HEX_LINE_BYTES < job->length ? line + HEX_LINE_BYTES : job->length;
+
+    return memcmp(job->data + line, sZeroLine, lineEnd - line) == 0;
+}
 
-    size_t step = 8;
-    size_t elementsPerLine = 4;
-    switch (bitWidth) {
-        case TypeBitWidth_64:
-            step = 8;
-            elementsPerLine = 4;
-            break;
-        case TypeBitWidth_32:
-            step = 4;
-            elementsPerLine = 8;
-            break;
+// "[index] = " in front of the first element of the line, after skipped lines
+static char* GenericBuffer_FormatDesignator(char* p, const HexFormatJob* job, size_t line, bool compact) {
+    return p + sprintf(p, compact ? "[%zu]=" : "[%zu] = ", line / job->step);
+}
 
-        case TypeBitWidth_16:
-            step = 2;
-            elementsPerLine = 16;
-            break;
+// "    0x0011, 0x2233, ... \n". an incomplete last element is padded with zeroes
+static char* GenericBuffer_FormatHexLine(char* p, const HexFormatJob* job, size_t line, size_t lineEnd,
+                                         bool designator) {
+    const uint8_t* data = job->data;
+    size_t step = job->step;
 
-        case TypeBitWidth_8:
-            step = 1;
-            elementsPerLine = 32;
-            break;
+    memcpy(p, "    ", 4);
+    p += 4;
+    if (designator) {
+        p = GenericBuffer_FormatDesignator(p, job, line, false);
+    }
 
-        default:
-            break;
+    for (size_t i = line; i < lineEnd; i += step) {
+        *p++ = '0';
+        *p++ = 'x';
+        if (i + step <= job->length) {
+            for (size_t j = 0; j < step; j++) {
+                memcpy(p, sHexPairs[data[i + j]], 2);
+                p += 2;
+            }
+        } else {
+            for (size_t j = 0; j < step; j++) {
+                memcpy(p, sHexPairs[i + j < job->length ? data[i + j] : 0], 2);
+                p += 2;
+            }
+        }
+        *p++ = ',';
+        *p++ = ' ';
+    }
+
+    *p++ = '\n';
+    return p;
+}
+
+// "17,0,255,...\n": decimal is the shortest for up to 32 bits, 64 bit elements are hex without leading zeroes so
+// they don't need a suffix
+static char* GenericBuffer_FormatCompactLine(char* p, const HexFormatJob* job, size_t line, size_t lineEnd,
+                                             bool designator) {
+    const uint8_t* data = job->data;
+    size_t step = job->step;
+
+    if (designator) {
+        p = GenericBuffer_FormatDesignator(p, job, line, true);
     }
 
-    size_t i;
-    for (i = 0; i < buffer->bufferLength; i += step) {
-        if ((i / step) % elementsPerLine == 0) {
-            fprintf(outFile, "    ");
+    for (size_t i = line; i < lineEnd; i += step) {
+        uint64_t value = 0;
+        char digits[20];
+        int count = 0;
+
+        for (size_t j = 0; j < step; j++) {
+            value = (value << 8) | (i + j < job->length ? data[i + j] : 0);
         }
 
-        switch (bitWidth) {
-            case TypeBitWidth_64:
-                fprintf(outFile, "0x%016" PRIX64 ", ", ToUInt64BE(buffer->buffer, i));
-                break;
+        if (step == 8) {
+            *p++ = '0';
+            *p++ = 'x';
+            do {
+                digits[count++] = HEX_DIGIT(value & 0xF);
+                value >>= 4;
+            } while (value != 0);
+        } else {
+            do {
+                digits[count++] = '0' + value % 10;
+                value /= 10;
+            } while (value != 0);
+        }
 
-            case TypeBitWidth_32:
-                fprintf(outFile, "0x%08" PRIX32 ", ", ToUInt32BE(buffer->buffer, i));
-                break;
+        while (count > 0) {
+            *p++ = digits[--count];
+        }
+        *p++ = ',';
+    }
 
-            case TypeBitWidth_16:
-                fprintf(outFile, "0x%04" PRIX16 ", ", ToUInt16BE(buffer->buffer, i));
+    *p++ = '\n';
+    return p;
+}
+
+// "\21\0\377AB...": printable characters stay as they are, the rest become octal escapes with as few digits
+// as possible. an escape only takes three digits if an octal digit follows it. ? is escaped to never form trigraphs
+static char* GenericBuffer_FormatStringLine(char* p, const HexFormatJob* job, size_t line, size_t lineEnd) {
+    const uint8_t* data = job->data;
+
+    *p++ = '"';
+
+    for (size_t i = line; i < lineEnd; i++) {
+        uint8_t c = data[i];
+
+        if (c >= ' ' && c <= '~') {
+            if (c == '"' || c == '\\' || c == '?') {
+                *p++ = '\\';
+            }
+            *p++ = c;
+        } else {
+            bool digitNext = i + 1 < lineEnd && data[i + 1] >= '0' && data[i + 1] <= '7';
+
+            *p++ = '\\';
+            if (c >= 0100 || digitNext) {
+                *p++ = '0' + (c >> 6);
+            }
+            if (c >= 010 || digitNext) {
+                *p++ = '0' + ((c >> 3) & 7);
+            }
+            *p++ = '0' + (c & 7);
+        }
+    }
+
+    *p++ = '"';
+    *p++ = '\n';
+    return p;
+}
+
+// formats every line of the job, the last one may be shorter.
+// when skipping zeroes, lines of only zeroes are left out and the line after them starts with a designator. if the
+// buffer ends in zeroes, its last element is written on its own so the array keeps its size. string literals can't
+// skip anything in the middle, but they are declared with their size, so the zeroes at the end can be dropped. if
+// that is all of them an empty literal is left, since empty braces are only valid from C23 on
+static void* GenericBuffer_FormatLines(void* arg) {
+    HexFormatJob* job = arg;
+    char* p = job->out;
+    bool skipped = job->skipZeros && job->start != 0 && GenericBuffer_IsZeroLine(job, job->start - HEX_LINE_BYTES);
+
+    for (size_t line = job->start; line < job->end; line += HEX_LINE_BYTES) {
+        size_t lineEnd = line + HEX_LINE_BYTES < job->end ? line + HEX_LINE_BYTES : job->end;
+
+        if (job->skipZeros) {
+            if (job->style == CArrayStyle_String ? line >= job->zeroTail : GenericBuffer_IsZeroLine(job, line)) {
+                skipped = true;
+                continue;
+            }
+        }
+
+        switch (job->style) {
+            case CArrayStyle_Hex:
+                p = GenericBuffer_FormatHexLine(p, job, line, lineEnd, skipped);
                 break;
 
-            case TypeBitWidth_8:
-                fprintf(outFile, "0x%02" PRIX8 ", ", ToUInt8BE(buffer->buffer, i));
+            case CArrayStyle_Compact:
+                p = GenericBuffer_FormatCompactLine(p, job, line, lineEnd, skipped);
                 break;
 
-            default:
+            case CArrayStyle_String:
+                p = GenericBuffer_FormatStringLine(p, job, line, lineEnd);
                 break;
         }
+        skipped = false;
+    }
+
+    if (skipped && job->end == job->length && job->style != CArrayStyle_String) {
+        size_t last = (job->length - 1) / job->step * job->step;
+
+        if (job->style == CArrayStyle_Hex) {
+            p = GenericBuffer_FormatHexLine(p, job, last, job->length, true);
+        } else {
+            p = GenericBuffer_FormatCompactLine(p, job, last, job->length, true);
+        }
+    }
+    if (job->style == CArrayStyle_String && job->start == 0 && job->zeroTail == 0) {
+        memcpy(p, "\"\"\n", 3);
+        p += 3;
+    }
+
+    job->outLength = p - job->out;
+    return NULL;
+}
+
+void GenericBuffer_WriteAsRawCArray(GenericBuffer* buffer, TypeBitWidth bitWidth, FILE* outFile) {
+    GenericBuffer_WriteAsRawCArrayStyled(buffer, bitWidth, CArrayStyle_Hex, false, outFile, 1);
+}
+
+// formats blocks of lines into memory, on several threads for big buffers, and writes each block at once.
+// CArrayStyle_String only works for 8 bit elements
+void GenericBuffer_WriteAsRawCArrayStyled(GenericBuffer* buffer, TypeBitWidth bitWidth, CArrayStyle style,
+                                          bool skipZeros, FILE* outFile, int threads) {
+    assert(buffer->hasData);
+    assert(bitWidth >= 0 && bitWidth < TypeBitWidth_Max);
+    assert(style != CArrayStyle_String || bitWidth == TypeBitWidth_8);
+    assert(outFile != NULL);
+
+    size_t length = buffer->bufferLength;
+    size_t blockSize = HEX_BLOCK_LINES * HEX_LINE_BYTES;
+    // one more line for the last element after skipped zeroes
+    size_t blockChars = (HEX_BLOCK_LINES + 1) * HEX_LINE_MAX_CHARS;
+    size_t zeroTail = (length + HEX_LINE_BYTES - 1) / HEX_LINE_BYTES * HEX_LINE_BYTES;
+
+    if (threads < 1 || length < HEX_PARALLEL_MIN_SIZE) {
+        threads = 1;
+    }
+
+    HexFormatJob* jobs = malloc(threads * sizeof(HexFormatJob));
+    pthread_t* threadIds = malloc(threads * sizeof(pthread_t));
+    char* out = malloc((size_t)threads * blockChars);
+    assert(jobs != NULL && threadIds != NULL && out != NULL);
+
+    if (skipZeros) {
+        while (zeroTail != 0 && memcmp(buffer->buffer + zeroTail - HEX_LINE_BYTES, sZeroLine,
+                                       (length < zeroTail ? length : zeroTail) - (zeroTail - HEX_LINE_BYTES)) == 0) {
+            zeroTail -= HEX_LINE_BYTES;
+        }
+    }
+
+    for (size_t start = 0; start < length; start += threads * blockSize) {
+        int count = 0;
+
+        for (int t = 0; t < threads && start + t * blockSize < length; t++) {
+            HexFormatJob* job = &jobs[t];
+
+            job->data = buffer->buffer;
+            job->length = length;
+            job->step = sBitWidthBytes[bitWidth];
+            job->style = style;
+            job->skipZeros = skipZeros;
+            job->zeroTail = zeroTail;
+            job->start = start + t * blockSize;
+            job->end = job->start + blockSize < length ? job->start + blockSize : length;
+            job->out = out + t * blockChars;
+            count++;
+        }
+
+        if (count == 1) {
+            GenericBuffer_FormatLines(&jobs[0]);
+        } else {
+            for (int t = 0; t < count; t++) {
+                int ret = pthread_create(&threadIds[t], NULL, GenericBuffer_FormatLines, &jobs[t]);
+                assert(ret == 0);
+                (void)ret;
+            }
+            for (int t = 0; t < count; t++) {
+                pthread_join(threadIds[t], NULL);
+            }
+        }
 
-        if ((i / step + 1) % elementsPerLine == 0) {
-            fprintf(outFile, "\n");
+        for (int t = 0; t < count; t++) {
+            fwrite(jobs[t].out, sizeof(char), jobs[t].outLength, outFile);
         }
     }
 
-    // Ensure there's a newline at the end
-    if ((i / step) % elementsPerLine != 0) {
-        fprintf(outFile, "\n");
+    free(out);
+    free(threadIds);
+    free(jobs);
+}
+
+// makes the length a multiple of alignment, adding fill bytes
+void GenericBuffer_Pad(GenericBuffer* buffer, size_t alignment, uint8_t fill) {
+    size_t length = (buffer->bufferLength + alignment - 1) / alignment * alignment;
+
+    if (length > buffer->bufferSize) {
+        buffer->buffer = realloc(buffer->buffer, length);
+        assert(buffer->buffer != NULL);
+        buffer->bufferSize = length;
     }
+    memset(buffer->buffer + buffer->bufferLength, fill, length - buffer->bufferLength);
+    buffer->bufferLength = length;
+}
+
+// reverses the bytes of every element, so the arrays written afterwards read the data as little endian. an incomplete
+// last element is padded with zeroes first, the same as the C array would
+void GenericBuffer_SwapElements(GenericBuffer* buffer, TypeBitWidth bitWidth) {
+    size_t step = sBitWidthBytes[bitWidth];
+
+    GenericBuffer_Pad(buffer, step, 0);
+    SwapArrayElements(buffer->buffer, buffer->bufferLength / step, step);
+}
+
+void GenericBuffer_WriteBinary(GenericBuffer* buffer, FILE* outFile) {
+    assert(buffer->hasData);
+    assert(outFile != NULL);
+
+    fwrite(buffer->buffer, sizeof(uint8_t), buffer->bufferLength, outFile);
 }
 
 void GenericBuffer_ReadBinary(GenericBuffer* buffer, FILE* inFile) {
@@ -108,51 +371,315 @@ void GenericBuffer_ReadBinary(GenericBuffer* buffer, FILE* inFile) {
     buffer->hasData = true;
 }
 
-void GenericBuffer_Yaz0Compress(GenericBuffer* buffer) {
+#define YAZ0_HEADER_SIZE 16
+
+static void GenericBuffer_WriteYaz0Header(uint8_t* dst, size_t uncompressedSize) {
+    memset(dst, 0, YAZ0_HEADER_SIZE);
+    dst[0] = 'Y';
+    dst[1] = 'a';
+    dst[2] = 'z';
+    dst[3] = '0';
+    FromUInt32ToBE(dst, 4, uncompressedSize);
+}
+
+void GenericBuffer_Yaz0Compress(GenericBuffer* buffer, yaz0_encoder* encoder) {
     assert(buffer->hasData);
     assert(!buffer->isCompressed);
 
     size_t uncompressedSize = buffer->bufferLength;
 
-    uint8_t* tempBuffer = malloc(uncompressedSize * sizeof(uint8_t) * 2);
+    // worst case is one "code" byte for every 8 literals
+    size_t maxSize = YAZ0_HEADER_SIZE + uncompressedSize + (uncompressedSize + 7) / 8;
+    uint8_t* compBuffer = malloc(maxSize * sizeof(uint8_t));
+    assert(compBuffer != NULL);
+
+    // compress data straight behind the header
+    size_t compSize = yaz0_encoder_encode(encoder, buffer->buffer, compBuffer + YAZ0_HEADER_SIZE, uncompressedSize);
+    assert(YAZ0_HEADER_SIZE + compSize <= maxSize);
+
+    GenericBuffer_WriteYaz0Header(compBuffer, uncompressedSize);
+
+    free(buffer->buffer);
+    buffer->buffer = compBuffer;
+    buffer->bufferSize = maxSize;
+    buffer->bufferLength = YAZ0_HEADER_SIZE + compSize;
+    buffer->isCompressed = true;
+}
+
+static void GenericBuffer_Yaz0Sink(void* userData, const uint8_t* data, int size) {
+    GenericBuffer* buffer = userData;
+
+    if (buffer->bufferLength + size > buffer->bufferSize) {
+        buffer->bufferSize *= 2;
+        buffer->buffer = realloc(buffer->buffer, buffer->bufferSize);
+        assert(buffer->buffer != NULL);
+    }
+
+    memcpy(buffer->buffer + buffer->bufferLength, data, size);
+    buffer->bufferLength += size;
+}
+
+// feeds the rest of inFile to the stream, a fixed size chunk at a time
+static bool GenericBuffer_Yaz0StreamFile(yaz0_stream* stream, FILE* inFile) {
+    uint8_t chunk[0x10000];
+    size_t readSize;
 
-    // compress data
-    size_t compSize = yaz0_encode(buffer->buffer, tempBuffer, uncompressedSize);
+    while ((readSize = fread(chunk, sizeof(uint8_t), sizeof(chunk), inFile)) > 0) {
+        yaz0_stream_write(stream, chunk, readSize);
+    }
+    if (ferror(inFile)) {
+        fprintf(stderr, "Error: Could not read the input file\n");
+        return false;
+    }
+    return true;
+}
 
-    // make Yaz0 header
-    uint8_t header[16] = { 0 };
-    header[0] = 'Y';
-    header[1] = 'a';
-    header[2] = 'z';
-    header[3] = '0';
-    FromUInt32ToBE(header, 4, uncompressedSize);
+// only the compressed data is kept, the input goes through a fixed size window
+bool GenericBuffer_Yaz0CompressFile(GenericBuffer* buffer, FILE* inFile, yaz0_encoder* encoder) {
+    assert(!buffer->hasData);
+
+    yaz0_stream stream;
 
-    memcpy(buffer->buffer, header, ARRAY_COUNT(header));
-    memcpy(buffer->buffer + ARRAY_COUNT(header), tempBuffer, compSize);
+    buffer->bufferSize = 0x10000;
+    buffer->buffer = malloc(buffer->bufferSize * sizeof(uint8_t));
+    assert(buffer->buffer != NULL);
+    buffer->bufferLength = YAZ0_HEADER_SIZE;
 
-    buffer->bufferLength = ARRAY_COUNT(header) + compSize;
+    yaz0_stream_init(&stream, encoder, GenericBuffer_Yaz0Sink, buffer);
+    if (!GenericBuffer_Yaz0StreamFile(&stream, inFile)) {
+        yaz0_stream_destroy(&stream);
+        return false;
+    }
+    yaz0_stream_finish(&stream);
+
+    GenericBuffer_WriteYaz0Header(buffer->buffer, stream.totalIn);
+    yaz0_stream_destroy(&stream);
+
+    buffer->hasData = true;
     buffer->isCompressed = true;
+    return true;
+}
+
+static void GenericBuffer_Yaz0FileSink(void* userData, const uint8_t* data, int size) {
+    fwrite(data, sizeof(uint8_t), size, userData);
+}
+
+// compresses the rest of inFile straight into outFile, so memory use doesn't grow with either of them. the header
+// comes first and needs the uncompressed size, which is taken from the size of the file
+bool GenericBuffer_Yaz0CompressFileTo(FILE* inFile, FILE* outFile, yaz0_encoder* encoder) {
+    uint8_t header[YAZ0_HEADER_SIZE];
+    yaz0_stream stream;
+
+    long start = ftell(inFile);
+    fseek(inFile, 0, SEEK_END);
+    long end = ftell(inFile);
+    fseek(inFile, start, SEEK_SET);
+    if (start < 0 || end < start) {
+        fprintf(stderr, "Error: Could not get the size of the input file\n");
+        return false;
+    }
+    if ((unsigned long)(end - start) > INT32_MAX) {
+        fprintf(stderr, "Error: Input of 0x%lX bytes is too big for Yaz0\n", end - start);
+        return false;
+    }
+
+    GenericBuffer_WriteYaz0Header(header, end - start);
+    fwrite(header, sizeof(uint8_t), sizeof(header), outFile);
+
+    yaz0_stream_init(&stream, encoder, GenericBuffer_Yaz0FileSink, outFile);
+    if (!GenericBuffer_Yaz0StreamFile(&stream, inFile)) {
+        yaz0_stream_destroy(&stream);
+        return false;
+    }
+    yaz0_stream_finish(&stream);
+    yaz0_stream_destroy(&stream);
 
-    free(tempBuffer);
+    if (stream.totalIn != (uint32_t)(end - start)) {
+        fprintf(stderr, "Error: The input file changed size while it was compressed\n");
+        return false;
+    }
+    return true;
 }
 
-void GenericBuffer_Yaz0Decompress(GenericBuffer* buffer) {
+bool GenericBuffer_Yaz0Decompress(GenericBuffer* buffer) {
     assert(buffer->hasData);
     assert(buffer->isCompressed);
 
-    if (buffer->buffer[0] != 'Y' || buffer->buffer[1] != 'a' || buffer->buffer[2] != 'z' || buffer->buffer[3] != '0') {
-        assert(!"Missing Yaz0 header");
+    if (buffer->bufferLength < YAZ0_HEADER_SIZE || buffer->buffer[0] != 'Y' || buffer->buffer[1] != 'a' ||
+        buffer->buffer[2] != 'z' || buffer->buffer[3] != '0') {
+        fprintf(stderr, "Error: Missing Yaz0 header\n");
+        return false;
     }
     size_t uncompressedSize = ToUInt32BE(buffer->buffer, 4);
+    if (uncompressedSize > INT32_MAX) {
+        fprintf(stderr, "Error: Yaz0 uncompressed size 0x%zX is too big\n", uncompressedSize);
+        return false;
+    }
 
     uint8_t* tempBuffer = malloc(uncompressedSize * sizeof(uint8_t));
+    assert(tempBuffer != NULL || uncompressedSize == 0);
+
+    int used = yaz0_decode(buffer->buffer + YAZ0_HEADER_SIZE, buffer->bufferLength - YAZ0_HEADER_SIZE, tempBuffer,
+                           uncompressedSize);
+    if (used < 0) {
+        fprintf(stderr, "Error: Corrupted Yaz0 data\n");
+        free(tempBuffer);
+        return false;
+    }
+
+    // the decompressed data is usually bigger than the allocation it came from
+    free(buffer->buffer);
+    buffer->buffer = tempBuffer;
+    buffer->bufferSize = uncompressedSize;
+    buffer->bufferLength = uncompressedSize;
+    buffer->isCompressed = false;
+
+    return true;
+}
+
+/* MIO0 and Yay0 */
+
+// both formats share a header layout and only differ in how links are coded
+typedef int (*SplitEncodeFunc)(yaz0_encoder* enc, uint8_t* src, uint8_t* dest, int srcSize, uint32_t* linkOffset,
+                               uint32_t* chunkOffset);
+typedef int (*SplitDecodeFunc)(const uint8_t* src, int srcSize, uint32_t linkOffset, uint32_t chunkOffset,
+                               uint8_t* dst, int uncompressedSize);
+
+#define SPLIT_HEADER_SIZE 16
+
+static void GenericBuffer_SplitCompress(GenericBuffer* buffer, yaz0_encoder* encoder, const char* magic,
+                                        size_t maxSize, SplitEncodeFunc encode) {
+    assert(buffer->hasData);
+    assert(!buffer->isCompressed);
+
+    size_t uncompressedSize = buffer->bufferLength;
+    uint8_t* compBuffer = malloc(maxSize * sizeof(uint8_t));
+    assert(compBuffer != NULL);
+
+    uint32_t linkOffset;
+    uint32_t chunkOffset;
+    size_t compSize = encode(encoder, buffer->buffer, compBuffer, uncompressedSize, &linkOffset, &chunkOffset);
+    assert(compSize <= maxSize);
+
+    memcpy(compBuffer, magic, 4);
+    FromUInt32ToBE(compBuffer, 4, uncompressedSize);
+    FromUInt32ToBE(compBuffer, 8, linkOffset);
+    FromUInt32ToBE(compBuffer, 12, chunkOffset);
+
+    free(buffer->buffer);
+    buffer->buffer = compBuffer;
+    buffer->bufferSize = maxSize;
+    buffer->bufferLength = compSize;
+    buffer->isCompressed = true;
+}
+
+static bool GenericBuffer_SplitDecompress(GenericBuffer* buffer, const char* magic, SplitDecodeFunc decode) {
+    assert(buffer->hasData);
+    assert(buffer->isCompressed);
 
-    yaz0_decode(buffer->buffer + 16, tempBuffer, uncompressedSize);
+    if (buffer->bufferLength < SPLIT_HEADER_SIZE || memcmp(buffer->buffer, magic, 4) != 0) {
+        fprintf(stderr, "Error: Missing %s header\n", magic);
+        return false;
+    }
+    size_t uncompressedSize = ToUInt32BE(buffer->buffer, 4);
+    if (uncompressedSize > INT32_MAX || buffer->bufferLength > INT32_MAX) {
+        fprintf(stderr, "Error: %s data is too big\n", magic);
+        return false;
+    }
 
-    memcpy(buffer->buffer, tempBuffer, uncompressedSize);
+    uint8_t* tempBuffer = malloc(uncompressedSize * sizeof(uint8_t));
+    assert(tempBuffer != NULL || uncompressedSize == 0);
+
+    if (decode(buffer->buffer, buffer->bufferLength, ToUInt32BE(buffer->buffer, 8), ToUInt32BE(buffer->buffer, 12),
+               tempBuffer, uncompressedSize) < 0) {
+        fprintf(stderr, "Error: Corrupted %s data\n", magic);
+        free(tempBuffer);
+        return false;
+    }
 
+    free(buffer->buffer);
+    buffer->buffer = tempBuffer;
+    buffer->bufferSize = uncompressedSize;
     buffer->bufferLength = uncompressedSize;
     buffer->isCompressed = false;
 
-    free(tempBuffer);
+    return true;
+}
+
+void GenericBuffer_Mio0Compress(GenericBuffer* buffer, yaz0_encoder* encoder) {
+    GenericBuffer_SplitCompress(buffer, encoder, "MIO0", MIO0_MAX_SIZE(buffer->bufferLength), mio0_encode);
+}
+
+bool GenericBuffer_Mio0Decompress(GenericBuffer* buffer) {
+    return GenericBuffer_SplitDecompress(buffer, "MIO0", mio0_decode);
+}
+
+void GenericBuffer_Yay0Compress(GenericBuffer* buffer, yaz0_encoder* encoder) {
+    GenericBuffer_SplitCompress(buffer, encoder, "Yay0", YAY0_MAX_SIZE(buffer->bufferLength), yay0_encode);
+}
+
+bool GenericBuffer_Yay0Decompress(GenericBuffer* buffer) {
+    return GenericBuffer_SplitDecompress(buffer, "Yay0", yay0_decode);
+}
+
+/* Any format */
+
+void GenericBuffer_Compress(GenericBuffer* buffer, CompressionFormat format, yaz0_encoder* encoder) {
+    switch (format) {
+        case CompressionFormat_Yaz0:
+            GenericBuffer_Yaz0Compress(buffer, encoder);
+            break;
+
+        case CompressionFormat_Mio0:
+            GenericBuffer_Mio0Compress(buffer, encoder);
+            break;
+
+        case CompressionFormat_Yay0:
+            GenericBuffer_Yay0Compress(buffer, encoder);
+            break;
+    }
+}
+
+// the format is told by the magic at the start of the header
+bool GenericBuffer_Decompress(GenericBuffer* buffer) {
+    assert(buffer->hasData);
+
+    if (buffer->bufferLength >= 4) {
+        if (memcmp(buffer->buffer, "Yaz0", 4) == 0) {
+            return GenericBuffer_Yaz0Decompress(buffer);
+        }
+        if (memcmp(buffer->buffer, "MIO0", 4) == 0) {
+            return GenericBuffer_Mio0Decompress(buffer);
+        }
+        if (memcmp(buffer->buffer, "Yay0", 4) == 0) {
+            return GenericBuffer_Yay0Decompress(buffer);
+        }
+    }
+
+    fprintf(stderr, "Error: Input is not Yaz0, MIO0 or Yay0 data\n");
+    return false;
+}
+
+// the compressed size is the whole file, header included, so it is the same
+// for every format and matches what ends up in the output. the decode cost
+// estimate is only known for yaz0
+void GenericBuffer_PrintCompressionStats(const GenericBuffer* buffer, const yaz0_cost_model* model, FILE* outFile) {
+    assert(buffer->isCompressed);
+
+    if (buffer->bufferLength < SPLIT_HEADER_SIZE) {
+        return;
+    }
+
+    size_t uncompressedSize = ToUInt32BE(buffer->buffer, 4);
+    size_t compSize = buffer->bufferLength;
+
+    fprintf(outFile, "%.4s: %zu -> %zu bytes (%.1f%%)", buffer->buffer, uncompressedSize, compSize,
+            uncompressedSize != 0 ? 100.0 * compSize / uncompressedSize : 0.0);
+    if (memcmp(buffer->buffer, "Yaz0", 4) == 0) {
+        uint64_t cycles = yaz0_decode_cost(buffer->buffer + YAZ0_HEADER_SIZE, compSize - YAZ0_HEADER_SIZE,
+                                           uncompressedSize, model);
+
+        fprintf(outFile, ", estimated decode cost %" PRIu64 " cycles", cycles);
+    }
+    fprintf(outFile, "\n");
 }
@@ -12,21 +12,46 @@
 
 /**
  * Options:
+ *   -a, --align            pad the data to a multiple of N bytes and align it to N, compressed data too; the
+ *                          palette is aligned too and becomes a declaration of var-namePal
+ *   -B, --bin-output       write the data to a binary file, the output becomes a wrapper including it
+ *   -C, --c-style          array element style: hex (default), compact or string (string literals, 8 bit only)
  *   -c, --c-type           C type to use as prefix for output array, defaults to value of -u
+ *   -d, --chain-depth      max match candidates per position when compressing (speed vs. ratio)
+ *   -E, --elf              write an ELF object (mips or host) instead of C, the palette too
  *   -e, --extra-prefix     Add an extra prefix, e.g. an alignment macro
+ *   -j, --jobs             threads used to search compression matches and to write big outputs
+ *   -n, --endian           byte order of the array elements: big (default) or little
+ *   -k, --decode-cost      decoder cycle estimates used by the 'cost' level and --stats
+ *   -f, --fill             byte to pad with for -a, default 0; an error without -a
  *   -i, --image-format     input type (jpeg or png) (optional, should try to guess from file extension and ...)
  *   -p, --pixel-format     texture output format, one of rgba32,rgba16,ia16,ia8,ia4,i8,i4,ci8,ci4 (yuv or whatever not
- *                          supported) (default is rgba16)
+ *                          supported) (default is rgba16), or a comma separated list decoding the image once; %p in
+ *                          -o, -B and -v becomes the format name
+ *   -M, --depfile          write a make style depfile for the output files, like gcc -MD -MF
  *   -o, --output-path      output file path (output to stdout if not specified)
+ *   -w, --wrapper          wrapper for -B: c (#embed) or asm (.incbin), the bin path is relative to the output's
+ *                          directory, which the assembler needs as -I
+ *   -z, --compression      compression format: yaz0 (default), mio0 or yay0; turns on compression without -y
+ *   -S, --section          section of the data in the ELF object, default .rodata
  *   -u, --bit-group-size   bytes per array element, one of 8,16, (without, default is chosen per type, 32/16/8 for
  *                          32/16/(8 or 4))
  *
  * Flags:
  *   -h, --help
+ *   -b, --blob             binary input; -y fast/nintendo compresses it while reading, straight into -B (not with
+ *                          -s), C and ELF output keep the compressed data in memory
+ *   -K, --self-check       compare the SIMD texture encoders the CPU supports against the scalar ones and exit
  *   -l, --palette          Rip the palette from a palettised PNG (should err if is not palettised) as rgba16; ignores
  *                          -f, print a warning
+ *   -N, --normalize        read the PNG as RGBA8: opaque alpha 0xFF, tRNS as alpha, palette PNGs in direct formats
  *   -r, --raw              output only the raw bytes in specified -u
- *   -y, --yaz0             compress output
+ *   -s, --stats            print compressed size (header included) and estimated decode cost to stderr
+ *   -U, --if-changed       only replace output files whose contents changed, atomically
+ *   -x, --decompress       read a Yaz0, MIO0 or Yay0 file and output its decompressed contents
+ *   -Z, --skip-zeros       leave out lines of zeroes, the compiler fills them in (designated initializers)
+ *   -y, --yaz0             compress output, optionally with a level: fast, nintendo (default), optimal or cost
+ *                          (cost weighs Yaz0 decoder cycles, only an estimate for mio0 and yay0)
  *
  * Positional argument:
  *   input-file             input file path
@@ -51,6 +76,10 @@ void PrintFlowAndIndent(const char* string, size_t initialColumn, size_t textWid
         shouldBreak = 0;
 
         if (column == textWidth) {
+            // a text ending right at the edge needs no new line
+            if (string[index] == '\0') {
+                return;
+            }
             printf("%c\n%*s", string[index], (int)hangingIndent, "");
             column = hangingIndent;
             continue;
@@ -9,10 +9,11 @@
 /* ImageBackend */
 
 void ImageBackend_Init(ImageBackend* image) {
-    image->pixelMatrix = NULL;
+    image->pixels = NULL;
+    image->stride = 0;
 
-    memset(image->colorPalette, 0, ARRAY_COUNT(image->colorPalette));
-    memset(image->alphaPalette, 0, ARRAY_COUNT(image->alphaPalette));
+    memset(image->colorPalette, 0, sizeof(image->colorPalette));
+    memset(image->alphaPalette, 0, sizeof(image->alphaPalette));
     image->paletteLen = ARRAY_COUNT(image->colorPalette);
 
     image->width = 0;
@@ -28,7 +29,77 @@ void ImageBackend_Destroy(ImageBackend* image) {
     ImageBackend_FreeImageData(image);
 }
 
-void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
+// all rows in one allocation, each starting IMAGE_BACKEND_ROW_ALIGNMENT aligned, so conversions walk memory linearly.
+// the contents are left uninitialized
+void ImageBackend_AllocPixels(ImageBackend* image, size_t rowBytes) {
+    image->stride = (rowBytes + IMAGE_BACKEND_ROW_ALIGNMENT - 1) / IMAGE_BACKEND_ROW_ALIGNMENT *
+                    IMAGE_BACKEND_ROW_ALIGNMENT;
+
+    size_t size = image->stride * image->height;
+    // aligned_alloc wants a multiple of the alignment, and something to allocate
+    size = (size + IMAGE_BACKEND_ALIGNMENT - 1) / IMAGE_BACKEND_ALIGNMENT * IMAGE_BACKEND_ALIGNMENT;
+    if (size == 0) {
+        size = IMAGE_BACKEND_ALIGNMENT;
+    }
+
+    image->pixels = aligned_alloc(IMAGE_BACKEND_ALIGNMENT, size);
+    assert(image->pixels != NULL);
+}
+
+uint8_t* ImageBackend_GetRow(const ImageBackend* image, size_t y) {
+    return image->pixels + y * image->stride;
+}
+
+// count pixels of row y starting at x, bounds checked once for the whole span instead of per pixel
+const uint8_t* ImageBackend_GetSpan(const ImageBackend* image, size_t y, size_t x, size_t count) {
+    assert(y < image->height);
+    assert(x <= image->width && count <= image->width - x);
+
+    if (ImageBackend_GetLayout(image) == ImageLayout_Indexed4) {
+        assert(x % 2 == 0);
+        return ImageBackend_GetRow(image, y) + x / 2;
+    }
+    return ImageBackend_GetRow(image, y) + x * (size_t)ImageBackend_GetBytesPerPixel(image);
+}
+
+ImageLayout ImageBackend_GetLayout(const ImageBackend* image) {
+    switch (image->colorType) {
+        case PNG_COLOR_TYPE_RGBA:
+            return ImageLayout_RGBA;
+
+        case PNG_COLOR_TYPE_RGB:
+            return ImageLayout_RGB;
+
+        case PNG_COLOR_TYPE_GRAY:
+            return ImageLayout_Gray;
+
+        case PNG_COLOR_TYPE_GRAY_ALPHA:
+            return ImageLayout_GrayAlpha;
+
+        case PNG_COLOR_TYPE_PALETTE:
+            return image->bitDepth == 4 ? ImageLayout_Indexed4 : ImageLayout_Indexed;
+
+        default:
+            fprintf(stderr, "image->colorType: %i\n", image->colorType);
+            assert(!"Invalid color type");
+            return ImageLayout_Max;
+    }
+}
+
+// for libpng, which wants a pointer to every row. free() the result
+static png_bytep* ImageBackend_GetRowPointers(const ImageBackend* image) {
+    png_bytep* rows = malloc(sizeof(png_bytep) * (image->height != 0 ? image->height : 1));
+    assert(rows != NULL);
+
+    for (size_t y = 0; y < image->height; y++) {
+        rows[y] = ImageBackend_GetRow(image, y);
+    }
+    return rows;
+}
+
+// expandToRGBA8 reads every color type as 8 bit RGBA, but palette images with keepPalette, see
+// ImageBackend_ReadPngRGBA8
+static void ImageBackend_ReadPngImpl(ImageBackend* image, FILE* inFile, bool expandToRGBA8, bool keepPalette) {
     assert(image != NULL);
     assert(inFile != NULL);
     ImageBackend_FreeImageData(image);
@@ -93,10 +164,33 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     // Read any color_type into 8bit depth, RGBA format.
     // See http://www.libpng.org/pub/png/libpng-manual.txt
 
-    if (image->bitDepth == 16)
+    if (image->bitDepth == 16) {
         png_set_strip_16(png);
+        image->bitDepth = 8;
+    }
 
-    if (image->colorType == PNG_COLOR_TYPE_PALETTE) {
+    bool expand = expandToRGBA8 && !(keepPalette && image->colorType == PNG_COLOR_TYPE_PALETTE);
+
+    if (expand) {
+        if (image->colorType == PNG_COLOR_TYPE_PALETTE)
+            png_set_palette_to_rgb(png);
+
+        if (image->colorType == PNG_COLOR_TYPE_GRAY && image->bitDepth < 8)
+            png_set_expand_gray_1_2_4_to_8(png);
+
+        if (image->colorType == PNG_COLOR_TYPE_GRAY || image->colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+            png_set_gray_to_rgb(png);
+
+        // the transparent color, or the alpha of each palette entry, becomes the alpha channel
+        if (png_get_valid(png, info, PNG_INFO_tRNS)) {
+            png_set_tRNS_to_alpha(png);
+        } else if (image->colorType != PNG_COLOR_TYPE_RGBA && image->colorType != PNG_COLOR_TYPE_GRAY_ALPHA) {
+            png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+        }
+
+        image->colorType = PNG_COLOR_TYPE_RGBA;
+        image->bitDepth = 8;
+    } else if (image->colorType == PNG_COLOR_TYPE_PALETTE) {
         // png_set_palette_to_rgb(png);
         image->isColorIndexed = true;
 
@@ -107,7 +201,7 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
         assert(paletteSizeTemp <= ARRAY_COUNT(image->colorPalette));
         image->paletteLen = paletteSizeTemp;
 
-        memcpy(image->colorPalette, colorPaletteTemp, paletteSizeTemp);
+        memcpy(image->colorPalette, colorPaletteTemp, paletteSizeTemp * sizeof(png_color));
 
 #ifdef TEXTURE_DEBUG
         {
@@ -122,15 +216,19 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
         }
 #endif
 
+        // entries tRNS doesn't cover, or all of them without one, are opaque
         png_byte* alphaPaletteTemp;
-        png_get_tRNS(png, info, &alphaPaletteTemp, &paletteSizeTemp, NULL);
-        assert(paletteSizeTemp <= ARRAY_COUNT(image->alphaPalette));
+        int alphaCount = 0;
 
-        memcpy(image->alphaPalette, alphaPaletteTemp, paletteSizeTemp);
+        memset(image->alphaPalette, 0xFF, sizeof(image->alphaPalette));
+        if (png_get_tRNS(png, info, &alphaPaletteTemp, &alphaCount, NULL) != 0) {
+            assert(alphaCount <= ARRAY_COUNT(image->alphaPalette));
+            memcpy(image->alphaPalette, alphaPaletteTemp, alphaCount);
+        }
 
 #ifdef TEXTURE_DEBUG
         {
-            printf("alpha\n  size: %i\n", paletteSizeTemp);
+            printf("alpha\n  size: %i\n", alphaCount);
             png_byte* aux = (png_byte*)image->colorPalette;
             for (size_t y = 0; y < image->paletteSize; y++) {
                 printf("%02X ", aux[y]);
@@ -142,31 +240,28 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
 #endif
     }
 
+    // Gray, gray + alpha and 4 bit indices are kept as they are in the png, the encoders read them directly.
     // PNG_COLOR_TYPE_GRAY_ALPHA is always 8 or 16bit depth.
-    if (image->colorType == PNG_COLOR_TYPE_GRAY && image->bitDepth < 8)
+    if (image->colorType == PNG_COLOR_TYPE_GRAY && image->bitDepth < 8) {
         png_set_expand_gray_1_2_4_to_8(png);
+        image->bitDepth = 8;
+    }
 
-    /*if (png_get_valid(png, info, PNG_INFO_tRNS))
-        png_set_tRNS_to_alpha(png);*/
-
-    // These color_type don't have an alpha channel then fill it with 0xff.
-    /*if(*color_type == PNG_COLOR_TYPE_RGB ||
-        *color_type == PNG_COLOR_TYPE_GRAY ||
-        *color_type == PNG_COLOR_TYPE_PALETTE)
-        png_set_filler(png, 0xFF, PNG_FILLER_AFTER);*/
-
-    if (image->colorType == PNG_COLOR_TYPE_GRAY || image->colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
-        png_set_gray_to_rgb(png);
+    // one byte per index, rows of packed 1 or 2 bit indices are shorter than the width
+    if (image->colorType == PNG_COLOR_TYPE_PALETTE && image->bitDepth < 4) {
+        png_set_packing(png);
+        image->bitDepth = 8;
+    }
 
     png_read_update_info(png, info);
 
     size_t rowBytes = png_get_rowbytes(png, info);
-    image->pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image->height);
-    for (size_t y = 0; y < image->height; y++) {
-        image->pixelMatrix[y] = (uint8_t*)malloc(rowBytes);
-    }
+    assert(!expand || rowBytes == (size_t)image->width * 4);
+    ImageBackend_AllocPixels(image, rowBytes);
 
-    png_read_image(png, image->pixelMatrix);
+    png_bytep* rows = ImageBackend_GetRowPointers(image);
+    png_read_image(png, rows);
+    free(rows);
 
 #ifdef TEXTURE_DEBUG
     printf("rowBytes: %zu\n", rowBytes);
@@ -177,7 +272,7 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     for (size_t y = 0; y < image->height; y++) {
         for (size_t x = 0; x < image->width; x++) {
             for (size_t z = 0; z < bytePerPixel; z++) {
-                printf("%02X ", image->pixelMatrix[y][x * bytePerPixel + z]);
+                printf("%02X ", ImageBackend_GetRow(image, y)[x * bytePerPixel + z]);
             }
             printf(" ");
         }
@@ -191,6 +286,16 @@ void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
     image->hasImageData = true;
 }
 
+void ImageBackend_ReadPng(ImageBackend* image, FILE* inFile) {
+    ImageBackend_ReadPngImpl(image, inFile, false, false);
+}
+
+// Every color type as tightly packed 8 bit RGBA: gray is expanded, tRNS and palette alpha become the alpha channel,
+// and pixels without alpha get 0xFF. keepPalette reads palette images color indexed instead, like ReadPng
+void ImageBackend_ReadPngRGBA8(ImageBackend* image, FILE* inFile, bool keepPalette) {
+    ImageBackend_ReadPngImpl(image, inFile, true, keepPalette);
+}
+
 void ImageBackend_WritePng(ImageBackend* image, FILE* outFile) {
     assert(image != NULL);
     assert(outFile != NULL);
@@ -254,14 +359,16 @@ void ImageBackend_WritePng(ImageBackend* image, FILE* outFile) {
     printf("imgData\n");
     for (size_t y = 0; y < image->height; y++) {
         for (size_t x = 0; x < image->width * bytePerPixel; x++) {
-            printf("%02X ", image->pixelMatrix[y][x]);
+            printf("%02X ", ImageBackend_GetRow(image, y)[x]);
         }
         printf("\n");
     }
     printf("\n");
 #endif
 
-    png_write_image(png, image->pixelMatrix);
+    png_bytep* rows = ImageBackend_GetRowPointers(image);
+    png_write_image(png, rows);
+    free(rows);
     png_write_end(png, NULL);
 
     png_destroy_write_struct(&png, &info);
@@ -280,10 +387,8 @@ void ImageBackend_InitEmptyRGBImage(ImageBackend* image, uint32_t nWidth, uint32
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
 
-    image->pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image->height);
-    for (size_t y = 0; y < image->height; y++) {
-        image->pixelMatrix[y] = (uint8_t*)calloc(image->width * bytePerPixel, sizeof(uint8_t*));
-    }
+    ImageBackend_AllocPixels(image, image->width * bytePerPixel);
+    memset(image->pixels, 0, image->stride * image->height);
 
     image->hasImageData = true;
     image->isColorIndexed = false;
@@ -299,33 +404,55 @@ void ImageBackend_InitEmptyPaletteImage(ImageBackend* image, uint32_t nWidth, ui
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
 
-    image->pixelMatrix = (uint8_t**)malloc(sizeof(uint8_t*) * image->height);
-    for (size_t y = 0; y < image->height; y++) {
-        image->pixelMatrix[y] = (uint8_t*)calloc(image->width * bytePerPixel, sizeof(uint8_t*));
-    }
-    memset(image->colorPalette, 0, ARRAY_COUNT(image->colorPalette));
-    memset(image->alphaPalette, 0, ARRAY_COUNT(image->alphaPalette));
+    ImageBackend_AllocPixels(image, image->width * bytePerPixel);
+    memset(image->pixels, 0, image->stride * image->height);
+    memset(image->colorPalette, 0, sizeof(image->colorPalette));
+    memset(image->alphaPalette, 0, sizeof(image->alphaPalette));
 
     image->hasImageData = true;
     image->isColorIndexed = true;
 }
 
+// the direct color pixel x of row, with alpha for the layouts without an alpha channel
+static RGBAPixel ImageBackend_ReadPixel(const ImageBackend* image, const uint8_t* row, size_t x, uint8_t alpha) {
+    RGBAPixel pixel;
+    const uint8_t* src;
+
+    switch (ImageBackend_GetLayout(image)) {
+        case ImageLayout_RGB:
+            src = &row[x * 3];
+            RGBAPixel_SetRGBA(&pixel, src[0], src[1], src[2], alpha);
+            break;
+
+        case ImageLayout_RGBA:
+            src = &row[x * 4];
+            RGBAPixel_SetRGBA(&pixel, src[0], src[1], src[2], src[3]);
+            break;
+
+        case ImageLayout_Gray:
+            RGBAPixel_SetGrayscale(&pixel, row[x], alpha);
+            break;
+
+        case ImageLayout_GrayAlpha:
+            src = &row[x * 2];
+            RGBAPixel_SetGrayscale(&pixel, src[0], src[1]);
+            break;
+
+        default:
+            assert(!"Not a direct color image");
+            RGBAPixel_Init(&pixel);
+            break;
+    }
+
+    return pixel;
+}
+
 RGBAPixel ImageBackend_GetPixel(const ImageBackend* image, size_t y, size_t x) {
     assert(y < image->height);
     assert(x < image->width);
     assert(!image->isColorIndexed);
 
-    RGBAPixel pixel;
-    RGBAPixel_Init(&pixel);
-
-    size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    pixel.r = image->pixelMatrix[y][x * bytePerPixel + 0];
-    pixel.g = image->pixelMatrix[y][x * bytePerPixel + 1];
-    pixel.b = image->pixelMatrix[y][x * bytePerPixel + 2];
-    if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-        pixel.a = image->pixelMatrix[y][x * bytePerPixel + 3];
-    }
-    return pixel;
+    return ImageBackend_ReadPixel(image, ImageBackend_GetRow(image, y), x, 0);
 }
 
 uint8_t ImageBackend_GetIndexedPixel(const ImageBackend* image, size_t y, size_t x) {
@@ -333,7 +460,12 @@ uint8_t ImageBackend_GetIndexedPixel(const ImageBackend* image, size_t y, size_t
     assert(x < image->width);
     //assert(image->isColorIndexed);
 
-    return image->pixelMatrix[y][x];
+    const uint8_t* row = ImageBackend_GetRow(image, y);
+
+    if (ImageBackend_GetLayout(image) == ImageLayout_Indexed4) {
+        return (x % 2 == 0) ? (row[x / 2] >> 4) : (row[x / 2] & 0xF);
+    }
+    return row[x];
 }
 
 RGBAPixel ImageBackend_GetPalettePixel(const ImageBackend* image, size_t index) {
@@ -355,13 +487,16 @@ void ImageBackend_SetRGBPixel(ImageBackend* image, size_t y, size_t x, uint8_t n
     assert(image->hasImageData);
     assert(y < image->height);
     assert(x < image->width);
+    assert(ImageBackend_GetLayout(image) == ImageLayout_RGB || ImageBackend_GetLayout(image) == ImageLayout_RGBA);
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    image->pixelMatrix[y][x * bytePerPixel + 0] = nR;
-    image->pixelMatrix[y][x * bytePerPixel + 1] = nG;
-    image->pixelMatrix[y][x * bytePerPixel + 2] = nB;
-    if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-        image->pixelMatrix[y][x * bytePerPixel + 3] = nA;
+    uint8_t* dst = ImageBackend_GetRow(image, y) + x * bytePerPixel;
+
+    dst[0] = nR;
+    dst[1] = nG;
+    dst[2] = nB;
+    if (ImageBackend_GetLayout(image) == ImageLayout_RGBA) {
+        dst[3] = nA;
     }
 }
 
@@ -369,13 +504,16 @@ void ImageBackend_SetGrayscalePixel(ImageBackend* image, size_t y, size_t x, uin
     assert(image->hasImageData);
     assert(y < image->height);
     assert(x < image->width);
+    assert(ImageBackend_GetLayout(image) == ImageLayout_RGB || ImageBackend_GetLayout(image) == ImageLayout_RGBA);
 
     size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    image->pixelMatrix[y][x * bytePerPixel + 0] = grayscale;
-    image->pixelMatrix[y][x * bytePerPixel + 1] = grayscale;
-    image->pixelMatrix[y][x * bytePerPixel + 2] = grayscale;
-    if (image->colorType == PNG_COLOR_TYPE_RGBA)
-        image->pixelMatrix[y][x * bytePerPixel + 3] = alpha;
+    uint8_t* dst = ImageBackend_GetRow(image, y) + x * bytePerPixel;
+
+    dst[0] = grayscale;
+    dst[1] = grayscale;
+    dst[2] = grayscale;
+    if (ImageBackend_GetLayout(image) == ImageLayout_RGBA)
+        dst[3] = alpha;
 }
 
 void ImageBackend_SetIndexedPixel(ImageBackend* image, size_t y, size_t x, uint8_t index, uint8_t grayscale) {
@@ -383,8 +521,18 @@ void ImageBackend_SetIndexedPixel(ImageBackend* image, size_t y, size_t x, uint8
     assert(y < image->height);
     assert(x < image->width);
 
-    size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
-    image->pixelMatrix[y][x * bytePerPixel + 0] = index;
+    uint8_t* row = ImageBackend_GetRow(image, y);
+
+    if (ImageBackend_GetLayout(image) == ImageLayout_Indexed4) {
+        assert(index < 16);
+        if (x % 2 == 0) {
+            row[x / 2] = (row[x / 2] & 0x0F) | (index << 4);
+        } else {
+            row[x / 2] = (row[x / 2] & 0xF0) | index;
+        }
+    } else {
+        row[x] = index;
+    }
 
     assert(index < image->paletteLen);
     png_color* pal = (png_color*)image->colorPalette;
@@ -407,9 +555,10 @@ void ImageBackend_SetPaletteIndex(ImageBackend* image, size_t index, uint8_t nR,
 
 void ImageBackend_SetPalette(ImageBackend* image, const ImageBackend* pal) {
     assert(image->isColorIndexed);
-    size_t bytePerPixel = ImageBackend_GetBytesPerPixel(pal);
 
     for (size_t y = 0; y < pal->height; y++) {
+        const uint8_t* row = ImageBackend_GetRow(pal, y);
+
         for (size_t x = 0; x < pal->width; x++) {
             size_t index = y * pal->width + x;
             if (index >= image->paletteLen) {
@@ -421,11 +570,8 @@ void ImageBackend_SetPalette(ImageBackend* image, const ImageBackend* pal) {
                 return;
             }
 
-            uint8_t r = pal->pixelMatrix[y][x * bytePerPixel + 0];
-            uint8_t g = pal->pixelMatrix[y][x * bytePerPixel + 1];
-            uint8_t b = pal->pixelMatrix[y][x * bytePerPixel + 2];
-            uint8_t a = pal->pixelMatrix[y][x * bytePerPixel + 3];
-            ImageBackend_SetPaletteIndex(image, index, r, g, b, a);
+            RGBAPixel pixel = ImageBackend_ReadPixel(pal, row, x, 255);
+            ImageBackend_SetPaletteIndex(image, index, pixel.r, pixel.g, pixel.b, pixel.a);
         }
     }
 }
@@ -433,22 +579,14 @@ void ImageBackend_SetPalette(ImageBackend* image, const ImageBackend* pal) {
 bool ImageBackend_ConvertToColorIndexed(ImageBackend* image) {
     assert(!image->isColorIndexed);
 
-    size_t bytePerPixel = ImageBackend_GetBytesPerPixel(image);
     size_t paletteMax = 0;
 
     // Create palette
     for (size_t y = 0; y < image->height; y++) {
-        for (size_t x = 0; x < image->width; x++) {
-            RGBAPixel pixel;
-            RGBAPixel_Init(&pixel);
+        uint8_t* row = ImageBackend_GetRow(image, y);
 
-            pixel.r = image->pixelMatrix[y][x * bytePerPixel + 0];
-            pixel.g = image->pixelMatrix[y][x * bytePerPixel + 1];
-            pixel.b = image->pixelMatrix[y][x * bytePerPixel + 2];
-            pixel.a = 255;
-            if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-                pixel.a = image->pixelMatrix[y][x * bytePerPixel + 3];
-            }
+        for (size_t x = 0; x < image->width; x++) {
+            RGBAPixel pixel = ImageBackend_ReadPixel(image, row, x, 255);
 
             bool wasColorPreviouslyAdded = false;
             for (size_t i = 0; i < paletteMax; i++) {
@@ -479,30 +617,23 @@ bool ImageBackend_ConvertToColorIndexed(ImageBackend* image) {
 
     // Palettize the pixel matrix
     for (size_t y = 0; y < image->height; y++) {
-        for (size_t x = 0; x < image->width; x++) {
-            RGBAPixel pixel;
-            RGBAPixel_Init(&pixel);
+        uint8_t* row = ImageBackend_GetRow(image, y);
 
-            pixel.r = image->pixelMatrix[y][x * bytePerPixel + 0];
-            pixel.g = image->pixelMatrix[y][x * bytePerPixel + 1];
-            pixel.b = image->pixelMatrix[y][x * bytePerPixel + 2];
-            pixel.a = 255;
-            if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-                pixel.a = image->pixelMatrix[y][x * bytePerPixel + 3];
-            }
+        for (size_t x = 0; x < image->width; x++) {
+            RGBAPixel pixel = ImageBackend_ReadPixel(image, row, x, 255);
 
             for (size_t i = 0; i < paletteMax; i++) {
                 RGBPixel* tempPixel = &image->colorPalette[i];
 
                 if (tempPixel->r == pixel.r && tempPixel->g == pixel.g && tempPixel->b == pixel.b) {
                     if (image->alphaPalette[i] == pixel.a) {
-                        // image->pixelMatrix[y][x * bytePerPixel + 0] = i;
-                        // image->pixelMatrix[y][x * bytePerPixel + 1] = i;
-                        // image->pixelMatrix[y][x * bytePerPixel + 2] = i;
+                        // row[x * bytePerPixel + 0] = i;
+                        // row[x * bytePerPixel + 1] = i;
+                        // row[x * bytePerPixel + 2] = i;
                         // if (image->colorType == PNG_COLOR_TYPE_RGBA) {
-                        //    image->pixelMatrix[y][x * bytePerPixel + 3] = i;
+                        //    row[x * bytePerPixel + 3] = i;
                         //}
-                        image->pixelMatrix[y][x] = i;
+                        row[x] = i;
                         break;
                     }
                 }
@@ -519,16 +650,22 @@ bool ImageBackend_ConvertToColorIndexed(ImageBackend* image) {
 }
 
 double ImageBackend_GetBytesPerPixel(const ImageBackend* image) {
-    switch (image->colorType) {
-        case PNG_COLOR_TYPE_RGBA:
-            return 4 * image->bitDepth / 8;
+    switch (ImageBackend_GetLayout(image)) {
+        case ImageLayout_RGBA:
+            return 4;
 
-        case PNG_COLOR_TYPE_GRAY:
-        case PNG_COLOR_TYPE_RGB:
-            return 3 * image->bitDepth / 8;
+        case ImageLayout_RGB:
+            return 3;
 
-        case PNG_COLOR_TYPE_PALETTE:
-            return 1 * image->bitDepth / 8;
+        case ImageLayout_GrayAlpha:
+            return 2;
+
+        case ImageLayout_Gray:
+        case ImageLayout_Indexed:
+            return 1;
+
+        case ImageLayout_Indexed4:
+            return 0.5;
 
         default:
             // throw std::invalid_argument("ImageBackend_GetBytesPerPixel(ImageBackend*
@@ -543,11 +680,9 @@ double ImageBackend_GetBytesPerPixel(const ImageBackend* image) {
 
 void ImageBackend_FreeImageData(ImageBackend* image) {
     if (image->hasImageData) {
-        for (size_t y = 0; y < image->height; y++) {
-            free(image->pixelMatrix[y]);
-        }
-        free(image->pixelMatrix);
-        image->pixelMatrix = NULL;
+        free(image->pixels);
+        image->pixels = NULL;
+        image->stride = 0;
     }
 
     if (image->isColorIndexed) {
@@ -13,54 +13,116 @@
 #include <string.h>
 #include <unistd.h>
 
+#include "depfile.h"
+#include "elf_object.h"
 #include "generic_buffer.h"
 #include "help.h"
 #include "image_backend.h"
 #include "macros.h"
 #include "png_texture.h"
 #include "jpeg_texture.h"
+#include "output_file.h"
+#include "yaz0/yaz0.h"
 
 /* Defines */
-#define OPTSRT "c:e:i:p:o:u:v:bhlry"
+#define OPTSRT "a:c:d:e:f:i:j:k:n:p:o:M:u:v:w:z:B:C:E::S:UbhKlNrsxy::Z"
 
 typedef enum {
     FORMAT_PNG,
     FORMAT_JPEG,
 } ImageFileFormat;
 
+typedef enum {
+    WRAPPER_EMBED,
+    WRAPPER_INCBIN,
+} WrapperKind;
+
 typedef struct {
     FILE* inputFile;
+    char* inputPath;
     FILE* outputFile;
+    char* outputPath;
     ImageFileFormat inputFileFormat;
-    TextureType pixelFormat;
+    TextureType pixelFormat; // the one being written
+    TextureType pixelFormats[TextureType_Max];
+    size_t pixelFormatCount;
     TypeBitWidth bitGroupSize; // Is this the right type to use here?
     char* extraPrefix;
     char* CType;
     char* varName;
     bool extractPalette;
     FILE* paletteFile;
+    char* palettePath;
+    char* depPath;
+    FILE* binFile;
+    char* binPath;
+    WrapperKind wrapperKind;
+    CArrayStyle cStyle;
+    bool skipZeros;
+    bool littleEndian;
+    size_t alignment;
+    uint8_t fill;
+    bool hasFill;
+    bool elfOut;
+    ElfTarget elfTarget;
+    char* elfSection;
 
     bool blobMode;
     bool rawOut;
     bool compress;
+    bool decompress;
+    CompressionFormat compressFormat;
+    yaz0_level compressLevel;
+    int compressMaxChain;
+    int jobs;
+    yaz0_cost_model decodeCost;
+    bool stats;
+    bool normalize;
+    bool ifChanged;
 
     bool verbose;
 } State;
 
 State gState = {
     .inputFile  = NULL,
+    .inputPath = NULL,
     .outputFile = NULL,
+    .outputPath = NULL,
     .inputFileFormat = -1,
     .pixelFormat = TextureType_rgba16,
+    .pixelFormats = { TextureType_rgba16 },
+    .pixelFormatCount = 1,
     .bitGroupSize = -1, 
     .extraPrefix = NULL,
     .CType = NULL,
     .varName = NULL,
     .extractPalette = false,
     .paletteFile = NULL,
+    .palettePath = NULL,
+    .depPath = NULL,
+    .binFile = NULL,
+    .binPath = NULL,
+    .wrapperKind = WRAPPER_EMBED,
+    .cStyle = CArrayStyle_Hex,
+    .skipZeros = false,
+    .littleEndian = false,
+    .alignment = 0,
+    .fill = 0,
+    .hasFill = false,
+    .elfOut = false,
+    .elfTarget = ElfTarget_Mips,
+    .elfSection = ".rodata",
     .blobMode = false,
     .rawOut = false,
     .compress = false,
+    .decompress = false,
+    .compressFormat = CompressionFormat_Yaz0,
+    .compressLevel = YAZ0_LEVEL_NINTENDO,
+    .compressMaxChain = YAZ0_DEFAULT_MAX_CHAIN,
+    .jobs = 1,
+    .stats = false,
+    .normalize = false,
+    .ifChanged = false,
     .verbose = false,
 };
 
@@ -88,6 +150,46 @@ PoorMansDict bitGroupSizeDict[] = {
     { NULL, -1 },
 };
 
+PoorMansDict yaz0LevelDict[] = {
+    { "fast", YAZ0_LEVEL_FAST },
+    { "nintendo", YAZ0_LEVEL_NINTENDO },
+    { "optimal", YAZ0_LEVEL_OPTIMAL },
+    { "cost", YAZ0_LEVEL_DECODE_COST },
+    { NULL, -1 },
+};
+
+PoorMansDict wrapperKindDict[] = {
+    { "c", WRAPPER_EMBED },
+    { "asm", WRAPPER_INCBIN },
+    { NULL, -1 },
+};
+
+PoorMansDict endianDict[] = {
+    { "big", false },
+    { "little", true },
+    { NULL, -1 },
+};
+
+PoorMansDict cStyleDict[] = {
+    { "hex", CArrayStyle_Hex },
+    { "compact", CArrayStyle_Compact },
+    { "string", CArrayStyle_String },
+    { NULL, -1 },
+};
+
+PoorMansDict elfTargetDict[] = {
+    { "mips", ElfTarget_Mips },
+    { "host", ElfTarget_Host },
+    { NULL, -1 },
+};
+
+PoorMansDict compressFormatDict[] = {
+    { "yaz0", CompressionFormat_Yaz0 },
+    { "mio0", CompressionFormat_Mio0 },
+    { "yay0", CompressionFormat_Yay0 },
+    { NULL, -1 },
+};
+
 int BadDictLookup(const char* string, const PoorMansDict* dict) {
     size_t i;
 
@@ -117,39 +219,38 @@ char* BadDictReverseLookup(char* dest, int eNum, const PoorMansDict* dict) {
     return NULL;
 }
 
-void ReadPng(GenericBuffer* buf, GenericBuffer* paletteBuf, FILE* inFile, TextureType texType, bool extractPalette) {
-    ImageBackend textureData;
-    ImageBackend_Init(&textureData);
-
-    ImageBackend_ReadPng(&textureData, inFile);
-
+// converting to a color indexed format changes the image for the formats after it, so those come last
+void ConvertPng(GenericBuffer* buf, GenericBuffer* paletteBuf, ImageBackend* textureData, TextureType texType,
+                bool extractPalette) {
     if (extractPalette) {
         assert(texType == TextureType_ci8 || texType == TextureType_ci4);
 
-        if (!textureData.isColorIndexed) {
+        if (!textureData->isColorIndexed) {
             // printf("converting!\n");
-            bool converted = ImageBackend_ConvertToColorIndexed(&textureData);
+            bool converted = ImageBackend_ConvertToColorIndexed(textureData);
             if (!converted) {
                 fprintf(stderr, "Error: Could not convert texture to color indexed format.\n");
                 exit(EXIT_FAILURE);
             }
         }
 
-        PngTexture_CopyPalette(paletteBuf, &textureData);
+        PngTexture_CopyPalette(paletteBuf, textureData);
+        // rgba16 colors
+        size_t colorCount = paletteBuf->bufferLength / 2;
 
         switch (texType) {
             case TextureType_ci8:
-                if (paletteBuf->bufferLength > 256) {
+                if (colorCount > 256) {
                     fprintf(stderr, "Error: Palette too big, can't fit on CI8 (256 colors). Palette size: %zu.\n",
-                            paletteBuf->bufferLength);
+                            colorCount);
                     exit(EXIT_FAILURE);
                 }
                 break;
 
             case TextureType_ci4:
-                if (paletteBuf->bufferLength > 16) {
+                if (colorCount > 16) {
                     fprintf(stderr, "Error: Palette too big, can't fit on CI4 (16 colors). Palette size: %zu.\n",
-                            paletteBuf->bufferLength);
+                            colorCount);
                     exit(EXIT_FAILURE);
                 }
                 break;
@@ -159,9 +260,7 @@ void ReadPng(GenericBuffer* buf, GenericBuffer* paletteBuf, FILE* inFile, Textur
         }
     }
 
-    PngTexture_CopyPng(buf, &textureData, texType);
-
-    ImageBackend_Destroy(&textureData);
+    PngTexture_CopyPng(buf, textureData, texType);
 }
 
 void ReadJpeg(GenericBuffer* buf, FILE* inFile) {
@@ -173,19 +272,38 @@ void ReadJpeg(GenericBuffer* buf, FILE* inFile) {
 
 // clang-format off
 static OptInfo optInfo[] = {
+    { { "align", required_argument, NULL, 'a' }, "N", "Pad the data to a multiple of N bytes and align the array, the wrapper symbol or the ELF data to N. N must be a power of two. The palette of -l is aligned the same way without padding; a C palette is then written as the declaration of var-namePal instead of bare elements. Compressed data is padded before and after compressing, so both the stored and the decompressed size are multiples of N" },
+    { { "c-style", required_argument, NULL, 'C' }, "STYLE", "Write the array elements as 'hex' (0x00AB, ), 'compact' (decimal without spaces) or 'string' (string literals, needs -u 8; with -r the array must be declared with the exact size). Default: hex" },
     { { "c-type", required_argument, NULL, 'c' }, "TYPE", "Use TYPE as the type of the C array generated. Default is u8/u16/u32/u64, same as -u" },
+    { { "chain-depth", required_argument, NULL, 'd' }, "DEPTH", "Examine at most DEPTH candidate matches per position when compressing. Lower is faster, higher compresses better. Default: 4096, which always finds the longest match" },
     { { "extra-prefix", required_argument, NULL, 'e' }, "PREFIX", "Add PREFIX before the C declaration, e.g. for attributes" },
+    { { "fill", required_argument, NULL, 'f' }, "BYTE", "Pad with BYTE for -a, only valid together with -a. Default: 0" },
     { { "image-format", required_argument, NULL, 'i' }, "IMG", "Read image as of format IMG. One of 'jpg', 'png'" },
-    { { "pixel-format", required_argument, NULL, 'p' }, "FMT", "Output pixel data in format FMT. One of rgba32, rgba16, ia16, ia8, ia4, i8, i4, ci8, ci4. Default: rgba16" },
+    { { "jobs", required_argument, NULL, 'j' }, "N", "Use N threads to search compression matches and to write big outputs, 0 for one per CPU. The output does not depend on N. Default: 1" },
+    { { "decode-cost", required_argument, NULL, 'k' }, "L,S,M,B[,W]", "Decoder cycles per literal, short match, long match and copied byte, and optionally cycles per compressed byte, used by -ycost and -s. Default: 10,22,26,5,19" },
+    { { "endian", required_argument, NULL, 'n' }, "ORDER", "Read the elements of the C array, and the palette, in byte order ORDER. One of 'big' (the N64's), 'little' (e.g. for a PC port, the array then has the same bytes in memory on a little endian machine). Default: big" },
+    { { "pixel-format", required_argument, NULL, 'p' }, "FMT", "Output pixel data in format FMT. One of rgba32, rgba16, ia16, ia8, ia4, i8, i4, ci8, ci4, or a comma separated list of them to decode the image once and write it in each. Every %p in -o, -B and -v is replaced by the format name, and without %p -v gets _FMT appended; -o without %p writes every array to the same file. Color indexed formats are written last. Default: rgba16" },
+    { { "depfile", required_argument, NULL, 'M' }, "FILE", "Write a make style dependency file to FILE, with the output files depending on the input file and on texture2c itself, like gcc -MD -MF FILE. Needs -o" },
     { { "output-path", required_argument, NULL, 'o' }, "FILE", "Write output to FILE, or stdout if not specified" },
     { { "bit-group-size", required_argument, NULL, 'u' }, "SIZE", "Number of bits in each array element of output. One of 8,16,32,64. Default is inferred from -p, 32 for rgba32, 16 for rgba16/ia16, 8 for the rest" },
+    { { "bin-output", required_argument, NULL, 'B' }, "FILE", "Write the data as raw binary to FILE, and make the output a wrapper including it (see -w)" },
+    { { "wrapper", required_argument, NULL, 'w' }, "KIND", "Wrapper written with -B. One of 'c' (array declaration with #embed, needs -u 8), 'asm' (symbol with .incbin). The wrapper names FILE relative to the output's directory; for 'asm' pass that directory to the assembler with -I. Default: c" },
+    { { "elf", optional_argument, NULL, 'E' }, "TARGET", "Write a relocatable ELF object defining var-name and var-name_size instead of C. TARGET is optional and must be attached to the flag (-ETARGET, --elf=TARGET). One of 'mips' (big endian, for the N64), 'host'. Default: mips" },
+    { { "section", required_argument, NULL, 'S' }, "NAME", "Put the data of -E in section NAME. Default: .rodata" },
     { { "var-name", required_argument, NULL, 'v' }, "NAME", "Use NAME as variable name of C array. Default: inputFileTex" },
+    { { "compression", required_argument, NULL, 'z' }, "FMT", "Compress the output in format FMT, with the level given by -y. Turns on compression by itself, so -y is only needed to pick a level. One of yaz0, mio0, yay0. Default: yaz0" },
     { { "palette", required_argument, NULL, 'l' }, "FILE", "Extract the palette a PNG uses instead of the image to FILE" },
 
     { { "help", no_argument, NULL, 'h' }, NULL, "Display this message and exit" },
-    { { "blob", no_argument, NULL, 'b' }, NULL, "Treat file as a binary blob rather than a texture" },
+    { { "blob", no_argument, NULL, 'b' }, NULL, "Treat file as a binary blob rather than a texture. With -y at the fast or nintendo level, yaz0, one job and no -a, the blob is compressed as it is read; with -B and without -s the output goes straight to the bin file too, so memory use stays the same whatever the size. C and ELF output still keep the compressed data in memory" },
+    { { "self-check", no_argument, NULL, 'K' }, NULL, "Check that every SIMD texture encoder the CPU supports writes the same bytes as the plain C one, on random images, and exit. The exit code is nonzero if one differs" },
+    { { "normalize", no_argument, NULL, 'N' }, NULL, "Read the PNG as 8 bit RGBA whatever its color type: pixels without alpha are opaque (alpha 0xFF instead of 0), tRNS transparency becomes alpha, and palette PNGs can be written in the direct color formats. ci4 and ci8 still use the palette of a palette PNG, which is decoded a second time for them when -p also has direct formats" },
     { { "raw", no_argument, NULL, 'r' }, NULL, "Output a raw array, i.e. only the contents of the {}. Ignores -c, -e, -v" },
-    { { "yaz0", no_argument, NULL, 'y' }, NULL, "Compress the output using yaz0" },
+    { { "stats", no_argument, NULL, 's' }, NULL, "Print the compressed size, header included, and the estimated decode cost for Yaz0, to stderr" },
+    { { "skip-zeros", no_argument, NULL, 'Z' }, NULL, "Leave out lines of zeroes and let the compiler fill them in, using designated initializers ([123] = ). With the string style only the zeroes at the end are left out. The compiled array does not change" },
+    { { "if-changed", no_argument, NULL, 'U' }, NULL, "Render the output, palette and bin-output files in memory and only replace them, atomically, if their contents changed, so build tools don't rebuild what depends on them" },
+    { { "decompress", no_argument, NULL, 'x' }, NULL, "Decompress a Yaz0, MIO0 or Yay0 file instead of reading a texture. Implies -b" },
+    { { "yaz0", optional_argument, NULL, 'y' }, "LEVEL", "Compress the output using yaz0. LEVEL is optional and must be attached to the flag (-yLEVEL, --yaz0=LEVEL). One of 'fast' (greedy), 'nintendo' (one step lookahead, same as Nintendo's encoder), 'optimal' (smallest output), 'cost' (smallest size plus decode time, see -k). The cost level uses the cycles of a Yaz0 decoder, so for mio0 and yay0 it only approximates their decode time. Default: nintendo" },
     { { NULL, 0, NULL, 0 }, NULL, NULL },
 };
 // clang-format on
@@ -201,7 +319,9 @@ void ConstructLongOpts(void) {
     }
 }
 
-void PrintVariablePre(FILE* outFile, const char* extraPrefix, const char* cType, const char* varName) {
+// count is the number of elements, or 0 to let the compiler count them
+void PrintVariablePre(FILE* outFile, const char* extraPrefix, const char* cType, const char* varName, size_t count,
+                      size_t alignment) {
     assert(outFile != NULL);
     assert(cType != NULL);
     assert(varName != NULL);
@@ -211,7 +331,15 @@ void PrintVariablePre(FILE* outFile, const char* extraPrefix, const char* cType,
     }
 
     assert(gState.varName != NULL);
-    fprintf(outFile, "%s %s[] = {\n", cType, varName);
+    if (count != 0) {
+        fprintf(outFile, "%s %s[%zu]", cType, varName, count);
+    } else {
+        fprintf(outFile, "%s %s[]", cType, varName);
+    }
+    if (alignment != 0) {
+        fprintf(outFile, " __attribute__((aligned(%zu)))", alignment);
+    }
+    fprintf(outFile, " = {\n");
 }
 
 void PrintVariablePost(FILE* outFile) {
@@ -220,6 +348,250 @@ void PrintVariablePost(FILE* outFile) {
     fprintf(outFile, "};\n");
 }
 
+// path made absolute, with "." and ".." resolved by name. symbolic links are left alone
+char* NormalizePath(const char* path) {
+    char cwd[4096] = "";
+
+    if (path[0] != '/' && getcwd(cwd, sizeof(cwd)) == NULL) {
+        fprintf(stderr, "Error: Can't get the current directory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char* parts[] = { cwd, path };
+    char* result = malloc(strlen(cwd) + strlen(path) + 2);
+    size_t length = 0;
+
+    assert(result != NULL);
+    // every name is appended as "/name"
+    for (size_t i = 0; i < ARRAY_COUNTU(parts); i++) {
+        const char* name = parts[i];
+
+        while (*name != '\0') {
+            const char* end = strchr(name, '/');
+            size_t nameLength = end != NULL ? (size_t)(end - name) : strlen(name);
+
+            if (nameLength == 2 && name[0] == '.' && name[1] == '.') {
+                while (length > 0 && result[--length] != '/') {}
+            } else if (nameLength != 0 && !(nameLength == 1 && name[0] == '.')) {
+                result[length++] = '/';
+                memcpy(&result[length], name, nameLength);
+                length += nameLength;
+            }
+            name += nameLength;
+            if (*name == '/') {
+                name++;
+            }
+        }
+    }
+    result[length] = '\0';
+
+    return result;
+}
+
+// the path the wrapper uses to find the binary file, relative to the directory of the output file. #embed looks
+// there first; .incbin only looks in the assembler's -I directories, so the output's directory has to be one of them.
+// the caller frees it
+char* GetBinIncludePath(void) {
+    if (gState.outputPath == NULL) {
+        char* result = malloc(strlen(gState.binPath) + 1);
+
+        assert(result != NULL);
+        strcpy(result, gState.binPath);
+        return result;
+    }
+
+    char* binPath = NormalizePath(gState.binPath);
+    char* outputPath = NormalizePath(gState.outputPath);
+    size_t common = 0;
+    size_t upCount = 0;
+
+    // the directories both paths start with
+    for (size_t i = 0; binPath[i] == outputPath[i] && binPath[i] != '\0'; i++) {
+        if (binPath[i] == '/') {
+            common = i + 1;
+        }
+    }
+    for (size_t i = common; outputPath[i] != '\0'; i++) {
+        if (outputPath[i] == '/') {
+            upCount++;
+        }
+    }
+
+    char* result = malloc(upCount * 3 + strlen(&binPath[common]) + 1);
+    size_t length = 0;
+
+    assert(result != NULL);
+    for (size_t i = 0; i < upCount; i++) {
+        memcpy(&result[length], "../", 3);
+        length += 3;
+    }
+    strcpy(&result[length], &binPath[common]);
+
+    free(binPath);
+    free(outputPath);
+    return result;
+}
+
+void PrintQuotedPath(FILE* outFile, const char* path) {
+    fputc('"', outFile);
+    for (; *path != '\0'; path++) {
+        if (*path == '"' || *path == '\\') {
+            fputc('\\', outFile);
+        }
+        fputc(*path, outFile);
+    }
+    fputc('"', outFile);
+}
+
+// the element size, or the alignment asked for if it is bigger
+size_t GetAlignment(void) {
+    size_t elementSize = 1 << gState.bitGroupSize;
+
+    return gState.alignment > elementSize ? gState.alignment : elementSize;
+}
+
+void PrintEmbedWrapper(FILE* outFile) {
+    if (!gState.rawOut) {
+        PrintVariablePre(outFile, gState.extraPrefix, gState.CType, gState.varName, 0, gState.alignment);
+    }
+
+    char* includePath = GetBinIncludePath();
+
+    fprintf(outFile, "#embed ");
+    PrintQuotedPath(outFile, includePath);
+    fprintf(outFile, "\n");
+    free(includePath);
+
+    if (!gState.rawOut) {
+        PrintVariablePost(outFile);
+    }
+}
+
+// aligned to the element size, like the C array would be, or to -a if that is more
+void PrintIncbinWrapper(FILE* outFile) {
+    if (!gState.rawOut) {
+        fprintf(outFile, ".section .rodata\n");
+        fprintf(outFile, ".balign %zu\n", GetAlignment());
+        fprintf(outFile, ".global %s\n", gState.varName);
+        fprintf(outFile, ".type %s, @object\n", gState.varName);
+        fprintf(outFile, "%s:\n", gState.varName);
+    }
+
+    char* includePath = GetBinIncludePath();
+
+    fprintf(outFile, ".incbin ");
+    PrintQuotedPath(outFile, includePath);
+    fprintf(outFile, "\n");
+    free(includePath);
+
+    if (!gState.rawOut) {
+        fprintf(outFile, ".size %s, . - %s\n", gState.varName, gState.varName);
+    }
+}
+
+// "rgba16,ci8". the color indexed formats are moved to the end, since converting the image to them can't be undone
+bool ParsePixelFormats(const char* list) {
+    TextureType formats[TextureType_Max];
+    size_t count = 0;
+    const char* start = list;
+
+    while (true) {
+        const char* end = strchr(start, ',');
+        size_t length = end != NULL ? (size_t)(end - start) : strlen(start);
+        char name[16];
+        int texType = -1;
+
+        if (length < sizeof(name)) {
+            memcpy(name, start, length);
+            name[length] = '\0';
+            texType = BadDictLookup(name, textureTypeDict);
+        }
+        if (texType < 0) {
+            fprintf(stderr, "\nError: Invalid pixel format list '%s'\n", list);
+            return false;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (formats[i] == (TextureType)texType) {
+                fprintf(stderr, "Error: Pixel format '%s' given twice\n", name);
+                return false;
+            }
+        }
+        formats[count++] = texType;
+
+        if (end == NULL) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    gState.pixelFormatCount = 0;
+    for (int colorIndexed = 0; colorIndexed < 2; colorIndexed++) {
+        for (size_t i = 0; i < count; i++) {
+            if ((formats[i] == TextureType_ci4 || formats[i] == TextureType_ci8) == colorIndexed) {
+                gState.pixelFormats[gState.pixelFormatCount++] = formats[i];
+            }
+        }
+    }
+    gState.pixelFormat = gState.pixelFormats[0];
+    return true;
+}
+
+// replaces every %p in pattern with the name of texType, or appends _name if there is none and append is set
+char* ExpandFormatName(const char* pattern, TextureType texType, bool append) {
+    char name[16];
+    size_t nameLength;
+
+    if (pattern == NULL) {
+        return NULL;
+    }
+
+    BadDictReverseLookup(name, texType, textureTypeDict);
+    nameLength = strlen(name);
+
+    char* expanded = malloc(strlen(pattern) / 2 * nameLength + strlen(pattern) + nameLength + 2);
+    char* p = expanded;
+    assert(expanded != NULL);
+
+    for (const char* c = pattern; *c != '\0'; c++) {
+        if (c[0] == '%' && c[1] == 'p') {
+            memcpy(p, name, nameLength);
+            p += nameLength;
+            c++;
+        } else {
+            *p++ = *c;
+        }
+    }
+    if (append && strstr(pattern, "%p") == NULL) {
+        *p++ = '_';
+        memcpy(p, name, nameLength);
+        p += nameLength;
+    }
+    *p = '\0';
+
+    return expanded;
+}
+
+// run before %p is expanded
+void CheckValidPixelFormatList(void) {
+    if (gState.pixelFormatCount == 1) {
+        return;
+    }
+
+    if (gState.blobMode || gState.inputFileFormat == FORMAT_JPEG) {
+        fprintf(stderr, "Error: Only PNG input can be written in several pixel formats\n");
+        exit(EXIT_FAILURE);
+    }
+    if (gState.elfOut && (gState.outputPath == NULL || strstr(gState.outputPath, "%p") == NULL)) {
+        fprintf(stderr, "Error: ELF output in several pixel formats needs %%p in -o, one object per format\n");
+        exit(EXIT_FAILURE);
+    }
+    if (gState.binPath != NULL && strstr(gState.binPath, "%p") == NULL) {
+        fprintf(stderr, "Error: bin-output in several pixel formats needs %%p in -B, one file per format\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
 void CheckValidProgramArguments(void) {
     if (!gState.rawOut) {
         if (gState.varName == NULL) {
@@ -229,21 +601,321 @@ void CheckValidProgramArguments(void) {
     }
 
     if (gState.extractPalette) {
-        switch (gState.pixelFormat) {
-            case TextureType_ci4:
-            case TextureType_ci8:
+        bool hasColorIndexed = false;
+
+        for (size_t i = 0; i < gState.pixelFormatCount; i++) {
+            if (gState.pixelFormats[i] == TextureType_ci4 || gState.pixelFormats[i] == TextureType_ci8) {
+                hasColorIndexed = true;
+            }
+        }
+        if (!hasColorIndexed) {
+            fprintf(stderr, "Error: Can't combine extraction with selected pixel format\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (gState.elfOut) {
+        if (gState.varName == NULL) {
+            fprintf(stderr, "Error: ELF output needs a var-name\n");
+            exit(EXIT_FAILURE);
+        }
+        if (gState.binPath != NULL) {
+            fprintf(stderr, "Error: Can't combine ELF output with bin-output\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (gState.hasFill && gState.alignment == 0) {
+        // nothing is padded without an alignment
+        fprintf(stderr, "Error: --fill only applies to the padding of --align, use -a\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (gState.depPath != NULL && gState.outputPath == NULL) {
+        fprintf(stderr, "Error: --depfile needs an output file, use -o\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (gState.littleEndian && (gState.elfOut || gState.binPath != NULL)) {
+        // the ELF target decides the byte order, and a binary file has no elements
+        fprintf(stderr, "Error: --endian only applies to C arrays, not to ELF or bin-output\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (gState.cStyle == CArrayStyle_String && gState.bitGroupSize != TypeBitWidth_8) {
+        fprintf(stderr, "Error: String literals need 8 bit elements, use -u 8\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (gState.binPath != NULL && gState.wrapperKind == WRAPPER_EMBED && gState.bitGroupSize != TypeBitWidth_8) {
+        // the bytes of the file become the elements of the array
+        fprintf(stderr, "Error: #embed needs 8 bit elements, use -u 8 or -w asm\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// one of the pixel formats to write, with the names it is written under
+typedef struct {
+    TextureType pixelFormat;
+    TypeBitWidth bitGroupSize;
+    char* CType;
+    char* varName;
+    char* outputPath;
+    char* binPath;
+} Variant;
+
+void SelectVariant(const Variant* variant) {
+    gState.pixelFormat = variant->pixelFormat;
+    gState.bitGroupSize = variant->bitGroupSize;
+    gState.CType = variant->CType;
+    gState.varName = variant->varName;
+    gState.outputPath = variant->outputPath;
+    gState.binPath = variant->binPath;
+}
+
+// the natural types of the pixel format being written, unless -u and -c say otherwise
+bool SetDefaultTypes(void) {
+    /* Natural types by default */
+    if (gState.bitGroupSize == (TypeBitWidth)-1) {
+        if (gState.blobMode) {
+            gState.bitGroupSize = TypeBitWidth_8;
+        } else {
+            switch (gState.pixelFormat) {
+                case TextureType_rgba32:
+                    gState.bitGroupSize = TypeBitWidth_32;
+                    break;
+
+                case TextureType_rgba16:
+                case TextureType_ia16:
+                    gState.bitGroupSize = TypeBitWidth_16;
+                    break;
+
+                case TextureType_i8:
+                case TextureType_ia8:
+                case TextureType_ci8:
+                case TextureType_i4:
+                case TextureType_ia4:
+                case TextureType_ci4:
+                    gState.bitGroupSize = TypeBitWidth_8;
+                    break;
+
+                default:
+                    fprintf(stderr, "error: unknown texture type specified\n");
+                    return false;
+            }
+        }
+    }
+
+    if (gState.CType != NULL) {
+        int size = 0;
+        if ((strcmp(gState.CType, "u64") == 0) && (gState.bitGroupSize != TypeBitWidth_64)) {
+            size = 64;
+        } else if ((strcmp(gState.CType, "u32") == 0) && (gState.bitGroupSize != TypeBitWidth_32)) {
+            size = 32;
+        } else if ((strcmp(gState.CType, "u16") == 0) && (gState.bitGroupSize != TypeBitWidth_16)) {
+            size = 16;
+        } else if ((strcmp(gState.CType, "u8") == 0) && (gState.bitGroupSize != TypeBitWidth_8)) {
+            size = 8;
+        }
+
+        if (size != 0) {
+            fprintf(stderr, "warning: c-type '%s' does not match bit-group-size %d\n", gState.CType,
+                   1 << (gState.bitGroupSize + 3));
+        }
+    } else {
+        /* Set default C type */
+        switch (gState.bitGroupSize) {
+            case TypeBitWidth_64:
+                gState.CType = "u64";
+                break;
+
+            case TypeBitWidth_32:
+                gState.CType = "u32";
+                break;
+
+            case TypeBitWidth_16:
+                gState.CType = "u16";
+                break;
+
+            case TypeBitWidth_8:
+                gState.CType = "u8";
                 break;
 
             default:
-                fprintf(stderr, "Error: Can't combine extraction with selected pixel format\n");
+                printf("error: unknown bit-group-size specified\n");
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// decodes or converts the input for the pixel format in gState, and writes it
+void WriteVariant(ImageBackend* image, bool* paletteWritten) {
+    GenericBuffer genericBuf;
+    GenericBuffer_Init(&genericBuf);
+
+    GenericBuffer paletteBuf;
+    GenericBuffer_Init(&paletteBuf);
+
+    // the compressed data went straight into the bin file
+    bool binWritten = false;
+
+    yaz0_encoder encoder;
+    if (gState.compress) {
+        yaz0_encoder_init(&encoder, gState.compressLevel, gState.compressMaxChain);
+        encoder.threads = gState.jobs;
+        encoder.costModel = gState.decodeCost;
+    }
+
+    if (gState.blobMode && gState.compress && !gState.decompress && gState.compressFormat == CompressionFormat_Yaz0 &&
+        gState.compressLevel != YAZ0_LEVEL_OPTIMAL && gState.compressLevel != YAZ0_LEVEL_DECODE_COST &&
+        gState.jobs == 1 && gState.alignment == 0) {
+        // compress while reading, so the whole input is never in memory.
+        // the optimal levels need to see everything at once to stay optimal,
+        // and so do the threads searching for matches. the other formats
+        // need all codes to lay out their streams, and padding needs the
+        // whole input before compressing. a bin file takes the output as it
+        // is compressed, the other outputs and the stats keep it in memory
+        if (gState.binFile != NULL && !gState.stats) {
+            binWritten = GenericBuffer_Yaz0CompressFileTo(gState.inputFile, gState.binFile, &encoder);
+            if (!binWritten) {
                 exit(EXIT_FAILURE);
+            }
+        } else if (!GenericBuffer_Yaz0CompressFile(&genericBuf, gState.inputFile, &encoder)) {
+            exit(EXIT_FAILURE);
+        }
+    } else if (gState.blobMode) {
+        GenericBuffer_ReadBinary(&genericBuf, gState.inputFile);
+
+        if (gState.decompress) {
+            GenericBuffer compressed;
+            GenericBuffer_Init(&compressed);
+
+            genericBuf.isCompressed = true;
+            if (gState.stats) {
+                // the stats are printed once the data decoded, the sizes in a
+                // corrupt header mean nothing
+                compressed = genericBuf;
+                compressed.buffer = malloc(genericBuf.bufferLength * sizeof(uint8_t));
+                assert(compressed.buffer != NULL || genericBuf.bufferLength == 0);
+                memcpy(compressed.buffer, genericBuf.buffer, genericBuf.bufferLength);
+            }
+            if (!GenericBuffer_Decompress(&genericBuf)) {
+                exit(EXIT_FAILURE);
+            }
+            if (gState.stats) {
+                GenericBuffer_PrintCompressionStats(&compressed, &gState.decodeCost, stderr);
+            }
+            GenericBuffer_Destroy(&compressed);
         }
+    } else if (gState.inputFileFormat == FORMAT_JPEG) {
+        ReadJpeg(&genericBuf, gState.inputFile);
+    } else {
+        bool colorIndexed = gState.pixelFormat == TextureType_ci4 || gState.pixelFormat == TextureType_ci8;
+
+        ConvertPng(&genericBuf, &paletteBuf, image, gState.pixelFormat, gState.extractPalette && colorIndexed);
     }
+
+    if (gState.compress) {
+        if (!genericBuf.isCompressed && !binWritten) {
+            if (gState.alignment != 0) {
+                // so the decompressed data fills an aligned buffer too
+                GenericBuffer_Pad(&genericBuf, gState.alignment, gState.fill);
+            }
+            GenericBuffer_Compress(&genericBuf, gState.compressFormat, &encoder);
+        }
+        yaz0_encoder_destroy(&encoder);
+
+        if (gState.stats) {
+            GenericBuffer_PrintCompressionStats(&genericBuf, &gState.decodeCost, stderr);
+        }
+    }
+
+    assert(gState.outputFile != NULL);
+
+    if (gState.alignment != 0) {
+        GenericBuffer_Pad(&genericBuf, gState.alignment, gState.fill);
+    }
+
+    if (gState.littleEndian) {
+        GenericBuffer_SwapElements(&genericBuf, gState.bitGroupSize);
+        if (paletteBuf.hasData) {
+            GenericBuffer_SwapElements(&paletteBuf, TypeBitWidth_16);
+        }
+    }
+
+    if (gState.elfOut) {
+        size_t elementSize = 1 << gState.bitGroupSize;
+
+        if (!ElfObject_Write(&genericBuf, gState.outputFile, gState.elfTarget, gState.elfSection, gState.varName,
+                             elementSize, GetAlignment())) {
+            exit(EXIT_FAILURE);
+        }
+    } else if (gState.binFile != NULL) {
+        if (!binWritten) {
+            GenericBuffer_WriteBinary(&genericBuf, gState.binFile);
+        }
+
+        switch (gState.wrapperKind) {
+            case WRAPPER_EMBED:
+                PrintEmbedWrapper(gState.outputFile);
+                break;
+
+            case WRAPPER_INCBIN:
+                PrintIncbinWrapper(gState.outputFile);
+                break;
+        }
+    } else {
+        if (!gState.rawOut) {
+            // a string literal initializing an array of exactly its length leaves out the terminating NUL
+            size_t count = gState.cStyle == CArrayStyle_String ? genericBuf.bufferLength : 0;
+
+            PrintVariablePre(gState.outputFile, gState.extraPrefix, gState.CType, gState.varName, count,
+                             gState.alignment);
+        }
+
+        GenericBuffer_WriteAsRawCArrayStyled(&genericBuf, gState.bitGroupSize, gState.cStyle, gState.skipZeros,
+                                             gState.outputFile, gState.jobs);
+
+        if (!gState.rawOut) {
+            PrintVariablePost(gState.outputFile);
+        }
+    }
+
+    // every color indexed format has the same palette, it is only written once. it is aligned like the texture, but
+    // not padded, the number of colors stays as it is
+    if (paletteBuf.hasData && !*paletteWritten) {
+        // rgba16 colors
+        size_t paletteAlignment = gState.alignment > 2 ? gState.alignment : 2;
+        char paletteName[256];
+
+        *paletteWritten = true;
+        snprintf(paletteName, sizeof(paletteName), "%sPal", gState.varName != NULL ? gState.varName : "");
+        if (gState.elfOut) {
+            if (!ElfObject_Write(&paletteBuf, gState.paletteFile, gState.elfTarget, gState.elfSection, paletteName, 2,
+                                 paletteAlignment)) {
+                exit(EXIT_FAILURE);
+            }
+        } else if (gState.alignment != 0 && !gState.rawOut) {
+            // a bare list of elements can't carry the alignment, so it gets a declaration of its own
+            PrintVariablePre(gState.paletteFile, gState.extraPrefix, "u16", paletteName, 0, gState.alignment);
+            GenericBuffer_WriteAsRawCArray(&paletteBuf, TypeBitWidth_16, gState.paletteFile);
+            PrintVariablePost(gState.paletteFile);
+        } else {
+            GenericBuffer_WriteAsRawCArray(&paletteBuf, TypeBitWidth_16, gState.paletteFile);
+        }
+    }
+
+    GenericBuffer_Destroy(&paletteBuf);
+    GenericBuffer_Destroy(&genericBuf);
 }
 
 int main(int argc, char** argv) {
     int opt;
 
+    gState.decodeCost = yaz0_default_cost_model;
+
     if (argc < 2) {
         // TODO
         fprintf(stderr, "Usage: %s [options] inputFile \n"
@@ -270,6 +942,19 @@ int main(int argc, char** argv) {
                 gState.CType = optarg;
                 break;
 
+            case 'd': {
+                char* end;
+
+                if (gState.verbose) {
+                    printf("Compression chain depth: %s\n", optarg);
+                }
+                gState.compressMaxChain = strtol(optarg, &end, 0);
+                if (*end != '\0' || gState.compressMaxChain <= 0) {
+                    fprintf(stderr, "Error: Invalid chain depth '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+
             case 'e':
                 if (gState.verbose) {
                     printf("Adding extra prefix: %s\n", optarg);
@@ -289,18 +974,100 @@ int main(int argc, char** argv) {
                 }
                 break;
 
+            case 'a': {
+                char* end;
+                unsigned long alignment = strtoul(optarg, &end, 0);
+
+                if (*end != '\0' || alignment == 0 || (alignment & (alignment - 1)) != 0) {
+                    fprintf(stderr, "Error: Invalid alignment '%s', must be a power of two\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                gState.alignment = alignment;
+            } break;
+
+            case 'f': {
+                char* end;
+                unsigned long fill = strtoul(optarg, &end, 0);
+
+                if (*end != '\0' || fill > 0xFF) {
+                    fprintf(stderr, "Error: Invalid fill byte '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                gState.fill = fill;
+                gState.hasFill = true;
+            } break;
+
+            case 'j': {
+                char* end;
+
+                if (gState.verbose) {
+                    printf("Threads: %s\n", optarg);
+                }
+                gState.jobs = strtol(optarg, &end, 0);
+                if (*end != '\0' || gState.jobs < 0) {
+                    fprintf(stderr, "Error: Invalid number of jobs '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                if (gState.jobs == 0) {
+                    gState.jobs = sysconf(_SC_NPROCESSORS_ONLN);
+                }
+                if (gState.jobs < 1) {
+                    gState.jobs = 1;
+                } else if (gState.jobs > YAZ0_MAX_THREADS) {
+                    gState.jobs = YAZ0_MAX_THREADS;
+                }
+            } break;
+
+            case 'k': {
+                uint32_t* fields[] = {
+                    &gState.decodeCost.literal,    &gState.decodeCost.shortMatch, &gState.decodeCost.longMatch,
+                    &gState.decodeCost.copiedByte, &gState.decodeCost.byteWeight,
+                };
+                char* str = optarg;
+                size_t i;
+
+                if (gState.verbose) {
+                    printf("Decode cost model: %s\n", optarg);
+                }
+                for (i = 0; i < ARRAY_COUNT(fields); i++) {
+                    char* end;
+
+                    *fields[i] = strtoul(str, &end, 0);
+                    if (end == str) {
+                        break;
+                    }
+                    str = end;
+                    if (*str != ',') {
+                        i++;
+                        break;
+                    }
+                    str++;
+                }
+                // the byte weight may be left out
+                if (*str != '\0' || i < ARRAY_COUNT(fields) - 1) {
+                    fprintf(stderr, "Error: Invalid decode cost '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+            } break;
+
             case 'p':
                 if (gState.verbose) {
                     printf("Output pixel format: %s\n", optarg);
                 }
-                gState.pixelFormat = (TextureType)BadDictLookup(optarg, textureTypeDict);
+                if (!ParsePixelFormats(optarg)) {
+                    exit(EXIT_FAILURE);
+                }
                 break;
 
             case 'o':
                 if (gState.verbose) {
                     printf("Output path: %s\n", optarg);
                 }
-                gState.outputFile = fopen(optarg, "w");
+                gState.outputPath = optarg;
+                break;
+
+            case 'M':
+                gState.depPath = optarg;
                 break;
 
             case 'u':
@@ -317,12 +1084,88 @@ int main(int argc, char** argv) {
                 gState.varName = optarg;
                 break;
 
+            case 'B':
+                if (gState.verbose) {
+                    printf("Binary output path: %s\n", optarg);
+                }
+                gState.binPath = optarg;
+                break;
+
+            case 'w': {
+                int kind = BadDictLookup(optarg, wrapperKindDict);
+
+                if (kind < 0) {
+                    fprintf(stderr, "\nError: Invalid wrapper '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                gState.wrapperKind = (WrapperKind)kind;
+            } break;
+
+            case 'C': {
+                int style = BadDictLookup(optarg, cStyleDict);
+
+                if (style < 0) {
+                    fprintf(stderr, "\nError: Invalid C style '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                gState.cStyle = (CArrayStyle)style;
+            } break;
+
+            case 'n': {
+                int order = BadDictLookup(optarg, endianDict);
+
+                if (order < 0) {
+                    fprintf(stderr, "\nError: Invalid byte order '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                gState.littleEndian = order;
+            } break;
+
+            case 'Z':
+                gState.skipZeros = true;
+                break;
+
+            case 'U':
+                gState.ifChanged = true;
+                break;
+
+            case 'E':
+                gState.elfOut = true;
+                if (optarg != NULL) {
+                    int target = BadDictLookup(optarg, elfTargetDict);
+
+                    if (target < 0) {
+                        fprintf(stderr, "\nError: Invalid ELF target '%s'\n", optarg);
+                        exit(EXIT_FAILURE);
+                    }
+                    gState.elfTarget = (ElfTarget)target;
+                }
+                break;
+
+            case 'S':
+                gState.elfSection = optarg;
+                break;
+
+            case 'z': {
+                int format = BadDictLookup(optarg, compressFormatDict);
+
+                if (gState.verbose) {
+                    printf("Compression format: %s\n", optarg);
+                }
+                if (format < 0) {
+                    fprintf(stderr, "\nError: Invalid compression format '%s'\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                gState.compressFormat = (CompressionFormat)format;
+                gState.compress = true;
+            } break;
+
             case 'l':
                 if (gState.verbose) {
                     printf("Extracting palette from PNG: %s\n", optarg);
                 }
                 gState.extractPalette = true;
-                gState.paletteFile = fopen(optarg, "w");
+                gState.palettePath = optarg;
                 break;
 
             /* Flags */
@@ -335,6 +1178,9 @@ int main(int argc, char** argv) {
                 PrintHelp(optCount, optInfo);
                 return EXIT_FAILURE;
 
+            case 'K':
+                return PngTexture_SelfCheck() ? EXIT_SUCCESS : EXIT_FAILURE;
+
             case 'r':
                 if (gState.verbose) {
                     printf("Raw mode selected.\n");
@@ -342,11 +1188,36 @@ int main(int argc, char** argv) {
                 gState.rawOut = true;
                 break;
 
+            case 'N':
+                gState.normalize = true;
+                break;
+
+            case 's':
+                gState.stats = true;
+                break;
+
+            case 'x':
+                if (gState.verbose) {
+                    printf("Decompressing input...\n");
+                }
+                gState.decompress = true;
+                gState.blobMode = true;
+                break;
+
             case 'y':
                 if (gState.verbose) {
                     printf("Compressing output...\n");
                 }
                 gState.compress = true;
+                if (optarg != NULL) {
+                    int level = BadDictLookup(optarg, yaz0LevelDict);
+
+                    if (level < 0) {
+                        fprintf(stderr, "\nError: Invalid yaz0 level '%s'\n", optarg);
+                        exit(EXIT_FAILURE);
+                    }
+                    gState.compressLevel = (yaz0_level)level;
+                }
                 break;
 
             default:
@@ -365,14 +1236,7 @@ int main(int argc, char** argv) {
             printf("Using input file: %s\n", argv[optind]);
         }
         gState.inputFile = fopen(argv[optind], "rb"); // What if it doesn't exist?
-    }
-
-    /**
-     * Set default output file.
-     * Have to do this since stdout is not constant.
-     */
-    if (gState.outputFile == NULL) {
-        gState.outputFile = stdout;
+        gState.inputPath = argv[optind];
     }
 
     /* Option interaction verification */
@@ -394,136 +1258,191 @@ int main(int argc, char** argv) {
         }
     }
 
-    /* Natural types by default */
-    if (gState.bitGroupSize == (TypeBitWidth)-1) {
-        if (gState.blobMode) {
-            gState.bitGroupSize = TypeBitWidth_8;
-        } else {
-            switch (gState.pixelFormat) {
-                case TextureType_rgba32:
-                    gState.bitGroupSize = TypeBitWidth_32;
-                    break;
+    CheckValidPixelFormatList();
 
-                case TextureType_rgba16:
-                case TextureType_ia16:
-                    gState.bitGroupSize = TypeBitWidth_16;
-                    break;
+    /**
+     * Everything that differs between the pixel formats: the types, and the names with %p expanded
+     */
+    Variant variants[TextureType_Max];
+    TypeBitWidth requestedBitGroupSize = gState.bitGroupSize;
+    char* requestedCType = gState.CType;
+    char* varNamePattern = gState.varName;
+    char* outputPathPattern = gState.outputPath;
+    char* binPathPattern = gState.binPath;
+    bool several = gState.pixelFormatCount > 1;
+
+    for (size_t i = 0; i < gState.pixelFormatCount; i++) {
+        Variant* variant = &variants[i];
+
+        gState.pixelFormat = gState.pixelFormats[i];
+        gState.bitGroupSize = requestedBitGroupSize;
+        gState.CType = requestedCType;
+        if (!SetDefaultTypes()) {
+            return EXIT_FAILURE;
+        }
 
-                case TextureType_i8:
-                case TextureType_ia8:
-                case TextureType_ci8:
-                case TextureType_i4:
-                case TextureType_ia4:
-                case TextureType_ci4:
-                    gState.bitGroupSize = TypeBitWidth_8;
-                    break;
+        variant->pixelFormat = gState.pixelFormat;
+        variant->bitGroupSize = gState.bitGroupSize;
+        variant->CType = gState.CType;
+        variant->varName = ExpandFormatName(varNamePattern, gState.pixelFormat, several);
+        variant->outputPath = ExpandFormatName(outputPathPattern, gState.pixelFormat, false);
+        variant->binPath = ExpandFormatName(binPathPattern, gState.pixelFormat, false);
 
-                default:
-                    fprintf(stderr, "error: unknown texture type specified\n");
-                    return EXIT_FAILURE;
-            }
-        }
+        SelectVariant(variant);
+        CheckValidProgramArguments();
     }
 
-    if (gState.CType != NULL) {
-        int size = 0;
-        if ((strcmp(gState.CType, "u64") == 0) && (gState.bitGroupSize != TypeBitWidth_64)) {
-            size = 64;
-        } else if ((strcmp(gState.CType, "u32") == 0) && (gState.bitGroupSize != TypeBitWidth_32)) {
-            size = 32;
-        } else if ((strcmp(gState.CType, "u16") == 0) && (gState.bitGroupSize != TypeBitWidth_16)) {
-            size = 16;
-        } else if ((strcmp(gState.CType, "u8") == 0) && (gState.bitGroupSize != TypeBitWidth_8)) {
-            size = 8;
-        }
+    assert(gState.inputFile != NULL);
 
-        if (size != 0) {
-            fprintf(stderr, "warning: c-type '%s' does not match bit-group-size %d\n", gState.CType,
-                   1 << (gState.bitGroupSize + 3));
+    // decoded once for all the pixel formats. with -N a palette PNG is decoded twice if the list mixes color indexed
+    // and direct formats: with its palette for the former, as RGBA for the latter
+    ImageBackend image;
+    ImageBackend indexedImage;
+    bool hasIndexedImage = false;
+    ImageBackend_Init(&image);
+    ImageBackend_Init(&indexedImage);
+
+    if (!gState.blobMode && gState.inputFileFormat != FORMAT_JPEG) {
+        if (gState.inputFileFormat != FORMAT_PNG) {
+            printf("Assuming PNG...\n");
         }
-    } else {
-        /* Set default C type */
-        switch (gState.bitGroupSize) {
-            case TypeBitWidth_64:
-                gState.CType = "u64";
-                break;
+        if (gState.normalize) {
+            // color indexed formats are sorted last
+            TextureType first = gState.pixelFormats[0];
+            TextureType last = gState.pixelFormats[gState.pixelFormatCount - 1];
+
+            ImageBackend_ReadPngRGBA8(&image, gState.inputFile,
+                                      last == TextureType_ci4 || last == TextureType_ci8);
+            if (image.isColorIndexed && first != TextureType_ci4 && first != TextureType_ci8) {
+                indexedImage = image;
+                hasIndexedImage = true;
+                ImageBackend_Init(&image);
+                rewind(gState.inputFile);
+                ImageBackend_ReadPngRGBA8(&image, gState.inputFile, false);
+            }
+        } else {
+            ImageBackend_ReadPng(&image, gState.inputFile);
 
-            case TypeBitWidth_32:
-                gState.CType = "u32";
-                break;
+            // a palette PNG stays color indexed, which only the color indexed formats can be written from. they are
+            // sorted last, so the first format tells if there is any other
+            TextureType first = gState.pixelFormats[0];
 
-            case TypeBitWidth_16:
-                gState.CType = "u16";
-                break;
+            if (image.isColorIndexed && first != TextureType_ci4 && first != TextureType_ci8) {
+                char name[16];
 
-            case TypeBitWidth_8:
-                gState.CType = "u8";
-                break;
-
-            default:
-                printf("error: unknown bit-group-size specified\n");
-                return EXIT_FAILURE;
+                BadDictReverseLookup(name, first, textureTypeDict);
+                fprintf(stderr, "Error: Can't write a palette PNG as %s, use -N to read it as RGBA\n", name);
+                exit(EXIT_FAILURE);
+            }
         }
     }
 
-    CheckValidProgramArguments();
-
-    assert(gState.inputFile != NULL);
-
-    GenericBuffer genericBuf;
-    GenericBuffer_Init(&genericBuf);
+    /**
+     * Open the output files once all options are known, since -U changes how.
+     * Formats sharing an output file write to it one after the other.
+     * Set default output file.
+     * Have to do this since stdout is not constant.
+     */
+    OutputFile output;
+    OutputFile palette;
+    OutputFile bin;
+    bool written = true;
+    bool paletteWritten = false;
+
+    if (gState.palettePath != NULL) {
+        if (!OutputFile_Open(&palette, gState.palettePath, gState.ifChanged)) {
+            return EXIT_FAILURE;
+        }
+        gState.paletteFile = palette.file;
+    }
 
-    GenericBuffer paletteBuf;
-    GenericBuffer_Init(&paletteBuf);
+    for (size_t i = 0; i < gState.pixelFormatCount; i++) {
+        const Variant* previous = i != 0 ? &variants[i - 1] : NULL;
 
-    if (gState.blobMode) {
-        GenericBuffer_ReadBinary(&genericBuf, gState.inputFile);
-    } else {
-        switch (gState.inputFileFormat) {
-            default:
-                printf("Assuming PNG...\n");
-            case FORMAT_PNG:
-                ReadPng(&genericBuf, &paletteBuf, gState.inputFile, gState.pixelFormat, gState.extractPalette);
-                break;
+        SelectVariant(&variants[i]);
 
-            case FORMAT_JPEG:
-                ReadJpeg(&genericBuf, gState.inputFile);
-                break;
+        if (previous == NULL || strcmp(previous->outputPath != NULL ? previous->outputPath : "",
+                                       gState.outputPath != NULL ? gState.outputPath : "") != 0) {
+            if (previous != NULL && previous->outputPath != NULL) {
+                written = OutputFile_Close(&output) && written;
+            }
+            if (gState.outputPath != NULL) {
+                if (!OutputFile_Open(&output, gState.outputPath, gState.ifChanged)) {
+                    return EXIT_FAILURE;
+                }
+            }
         }
-    }
+        gState.outputFile = gState.outputPath != NULL ? output.file : stdout;
 
-    if (gState.compress) {
-        GenericBuffer_Yaz0Compress(&genericBuf);
-    }
+        if (gState.binPath != NULL) {
+            if (!OutputFile_Open(&bin, gState.binPath, gState.ifChanged)) {
+                return EXIT_FAILURE;
+            }
+            gState.binFile = bin.file;
+        }
 
-    assert(gState.outputFile != NULL);
+        if (hasIndexedImage && (gState.pixelFormat == TextureType_ci4 || gState.pixelFormat == TextureType_ci8)) {
+            WriteVariant(&indexedImage, &paletteWritten);
+        } else {
+            WriteVariant(&image, &paletteWritten);
+        }
 
-    if (!gState.rawOut) {
-        PrintVariablePre(gState.outputFile, gState.extraPrefix, gState.CType, gState.varName);
+        if (gState.binFile != NULL) {
+            written = OutputFile_Close(&bin) && written;
+            gState.binFile = NULL;
+        }
     }
 
-    GenericBuffer_WriteAsRawCArray(&genericBuf, gState.bitGroupSize, gState.outputFile);
-
-    if (!gState.rawOut) {
-        PrintVariablePost(gState.outputFile);
+    if (gState.outputFile != stdout) {
+        written = OutputFile_Close(&output) && written;
     }
-
-    if (paletteBuf.hasData) {
-        GenericBuffer_WriteAsRawCArray(&paletteBuf, TypeBitWidth_16, gState.paletteFile);
+    if (gState.paletteFile != NULL) {
+        written = OutputFile_Close(&palette) && written;
     }
 
-    GenericBuffer_Destroy(&paletteBuf);
-    GenericBuffer_Destroy(&genericBuf);
+    ImageBackend_Destroy(&image);
+    ImageBackend_Destroy(&indexedImage);
 
     if (gState.inputFile != stdin) {
         fclose(gState.inputFile);
     }
-    if (gState.outputFile != stdout) {
-        fclose(gState.outputFile);
+
+    // last, so a failed run never leaves a depfile claiming its outputs are up to date
+    if (written && gState.depPath != NULL) {
+        const char* targetPaths[2 * TextureType_Max + 1];
+        size_t targetCount = 0;
+        char* toolPath = Depfile_GetToolPath(argv[0]);
+        const char* prerequisites[] = { gState.inputPath, toolPath };
+        OutputFile dep;
+
+        for (size_t i = 0; i < gState.pixelFormatCount; i++) {
+            // a shared output file is listed once
+            if (i == 0 || strcmp(variants[i].outputPath, variants[i - 1].outputPath) != 0) {
+                targetPaths[targetCount++] = variants[i].outputPath;
+            }
+        }
+        if (gState.palettePath != NULL) {
+            targetPaths[targetCount++] = gState.palettePath;
+        }
+        for (size_t i = 0; i < gState.pixelFormatCount; i++) {
+            if (variants[i].binPath != NULL) {
+                targetPaths[targetCount++] = variants[i].binPath;
+            }
+        }
+
+        written = OutputFile_Open(&dep, gState.depPath, gState.ifChanged);
+        if (written) {
+            Depfile_Write(dep.file, targetPaths, targetCount, prerequisites, ARRAY_COUNTU(prerequisites));
+            written = OutputFile_Close(&dep);
+        }
+        free(toolPath);
     }
-    if (gState.paletteFile != NULL) {
-        fclose(gState.paletteFile);
+
+    for (size_t i = 0; i < gState.pixelFormatCount; i++) {
+        free(variants[i].varName);
+        free(variants[i].outputPath);
+        free(variants[i].binPath);
     }
 
-    return EXIT_SUCCESS;
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
 }
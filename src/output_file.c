@@ -0,0 +1,118 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "output_file.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define COMPARE_CHUNK_SIZE 0x10000
+
+bool OutputFile_Open(OutputFile* out, const char* path, bool ifChanged) {
+    out->path = path;
+    out->ifChanged = ifChanged;
+    out->data = NULL;
+    out->size = 0;
+
+    if (ifChanged) {
+        out->file = open_memstream(&out->data, &out->size);
+    } else {
+        out->file = fopen(path, "wb");
+    }
+
+    if (out->file == NULL) {
+        fprintf(stderr, "Error: Could not open '%s' for writing\n", path);
+        return false;
+    }
+    return true;
+}
+
+// compares the size first, so most changed files are never read
+static bool OutputFile_IsSame(const OutputFile* out) {
+    struct stat st;
+
+    if (stat(out->path, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size != out->size) {
+        return false;
+    }
+
+    FILE* file = fopen(out->path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    char* chunk = malloc(COMPARE_CHUNK_SIZE);
+    bool same = true;
+    size_t offset = 0;
+    assert(chunk != NULL);
+
+    while (same && offset < out->size) {
+        size_t length = out->size - offset < COMPARE_CHUNK_SIZE ? out->size - offset : COMPARE_CHUNK_SIZE;
+
+        same = fread(chunk, 1, length, file) == length && memcmp(chunk, out->data + offset, length) == 0;
+        offset += length;
+    }
+
+    free(chunk);
+    fclose(file);
+    return same;
+}
+
+// writes a temporary file next to the output and renames it over the output, so readers never see half a file
+static bool OutputFile_Replace(const OutputFile* out) {
+    size_t pathLength = strlen(out->path);
+    char* tempPath = malloc(pathLength + sizeof(".XXXXXX"));
+    assert(tempPath != NULL);
+
+    memcpy(tempPath, out->path, pathLength);
+    memcpy(tempPath + pathLength, ".XXXXXX", sizeof(".XXXXXX"));
+
+    int fd = mkstemp(tempPath);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not create a temporary file for '%s'\n", out->path);
+        free(tempPath);
+        return false;
+    }
+
+    // mkstemp makes the file private, give it the permissions fopen would have
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+
+    FILE* file = fdopen(fd, "wb");
+    bool written = file != NULL && fwrite(out->data, 1, out->size, file) == out->size;
+
+    if (file != NULL) {
+        written = fclose(file) == 0 && written;
+    } else {
+        close(fd);
+    }
+
+    if (!written || rename(tempPath, out->path) != 0) {
+        fprintf(stderr, "Error: Could not write '%s'\n", out->path);
+        remove(tempPath);
+        free(tempPath);
+        return false;
+    }
+
+    free(tempPath);
+    return true;
+}
+
+bool OutputFile_Close(OutputFile* out) {
+    bool ok = fclose(out->file) == 0;
+
+    out->file = NULL;
+    if (!out->ifChanged) {
+        return ok;
+    }
+
+    if (ok && !OutputFile_IsSame(out)) {
+        ok = OutputFile_Replace(out);
+    }
+
+    free(out->data);
+    out->data = NULL;
+    return ok;
+}
@@ -5,175 +5,809 @@
 #include <string.h>
 
 #include "bit_convert.h"
+#include "macros.h"
 #include "yaz0/yaz0.h"
 
-void PngTexture_CopyRgba16(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PNG_TEXTURE_X86_SIMD
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PNG_TEXTURE_NEON
+#endif
+
+// Quantizers, indexed by an 8 bit channel and already shifted into place.
+// LUT_256(f) expands to f(0), f(1), ..., f(255)
+#define LUT_4(f, v) f(v), f((v) + 1), f((v) + 2), f((v) + 3)
+#define LUT_16(f, v) LUT_4(f, v), LUT_4(f, (v) + 4), LUT_4(f, (v) + 8), LUT_4(f, (v) + 12)
+#define LUT_64(f, v) LUT_16(f, v), LUT_16(f, (v) + 16), LUT_16(f, (v) + 32), LUT_16(f, (v) + 48)
+#define LUT_256(f) LUT_64(f, 0), LUT_64(f, 64), LUT_64(f, 128), LUT_64(f, 192)
+
+#define QUANTIZE_RGBA16_R(v) (((v) / 8) << 11)
+#define QUANTIZE_RGBA16_G(v) (((v) / 8) << 6)
+#define QUANTIZE_RGBA16_B(v) (((v) / 8) << 1)
+#define QUANTIZE_4_HIGH(v) (((v) / 16) << 4)
+#define QUANTIZE_4_LOW(v) ((v) / 16)
+#define QUANTIZE_IA4_I(v) (((v) / 32) << 1)
+
+static const uint16_t sRgba16Red[256] = { LUT_256(QUANTIZE_RGBA16_R) };
+static const uint16_t sRgba16Green[256] = { LUT_256(QUANTIZE_RGBA16_G) };
+static const uint16_t sRgba16Blue[256] = { LUT_256(QUANTIZE_RGBA16_B) };
+static const uint8_t sHigh4[256] = { LUT_256(QUANTIZE_4_HIGH) };
+static const uint8_t sLow4[256] = { LUT_256(QUANTIZE_4_LOW) };
+static const uint8_t sIa4Intensity[256] = { LUT_256(QUANTIZE_IA4_I) };
+
+// Channels of the pixel at p, per source layout. Without an alpha channel alpha reads as 0, like ImageBackend_GetPixel
+#define PIXEL_RGB_R(p) ((p)[0])
+#define PIXEL_RGB_G(p) ((p)[1])
+#define PIXEL_RGB_B(p) ((p)[2])
+#define PIXEL_RGB_A(p) 0
+#define PIXEL_RGBA_R(p) ((p)[0])
+#define PIXEL_RGBA_G(p) ((p)[1])
+#define PIXEL_RGBA_B(p) ((p)[2])
+#define PIXEL_RGBA_A(p) ((p)[3])
+#define PIXEL_GRAY_R(p) ((p)[0])
+#define PIXEL_GRAY_G(p) ((p)[0])
+#define PIXEL_GRAY_B(p) ((p)[0])
+#define PIXEL_GRAY_A(p) 0
+#define PIXEL_GRAYA_R(p) ((p)[0])
+#define PIXEL_GRAYA_G(p) ((p)[0])
+#define PIXEL_GRAYA_B(p) ((p)[0])
+#define PIXEL_GRAYA_A(p) ((p)[1])
+
+// Encoders write one step of pixels at src, bpp bytes apart, to dst. px is the PIXEL_ prefix of the source layout
+#define ENCODE_RGBA16(dst, src, bpp, px)                                                                     \
+    do {                                                                                                     \
+        uint16_t data = sRgba16Red[px##_R(src)] | sRgba16Green[px##_G(src)] | sRgba16Blue[px##_B(src)] |    \
+                        (px##_A(src) != 0);                                                                  \
+        (dst)[0] = data >> 8;                                                                                \
+        (dst)[1] = data & 0xFF;                                                                              \
+    } while (0)
+
+#define ENCODE_RGBA32(dst, src, bpp, px) \
+    do {                                 \
+        (dst)[0] = px##_R(src);          \
+        (dst)[1] = px##_G(src);          \
+        (dst)[2] = px##_B(src);          \
+        (dst)[3] = px##_A(src);          \
+    } while (0)
+
+#define ENCODE_I4(dst, src, bpp, px) (dst)[0] = sHigh4[px##_R(src)] | sLow4[px##_R((src) + (bpp))]
+
+#define ENCODE_I8(dst, src, bpp, px) (dst)[0] = px##_R(src)
+
+#define ENCODE_IA4(dst, src, bpp, px)                                                \
+    (dst)[0] = ((sIa4Intensity[px##_R(src)] | (px##_A(src) != 0)) << 4) |           \
+               sIa4Intensity[px##_R((src) + (bpp))] | (px##_A((src) + (bpp)) != 0)
+
+#define ENCODE_IA8(dst, src, bpp, px) (dst)[0] = sHigh4[px##_R(src)] | sLow4[px##_A(src)]
+
+#define ENCODE_IA16(dst, src, bpp, px) \
+    do {                               \
+        (dst)[0] = px##_R(src);        \
+        (dst)[1] = px##_A(src);        \
+    } while (0)
+
+#define ENCODE_CI4(dst, src, bpp, px) (dst)[0] = ((src)[0] << 4) | (src)[1]
+
+#define ENCODE_CI8(dst, src, bpp, px) (dst)[0] = (src)[0]
+
+// X(type, pixels per step, bytes written per step, encoder) for the formats encoded from direct color pixels
+#define PNG_TEXTURE_DIRECT_ENCODERS(X) \
+    X(rgba16, 1, 2, ENCODE_RGBA16)     \
+    X(rgba32, 1, 4, ENCODE_RGBA32)     \
+    X(i4, 2, 1, ENCODE_I4)             \
+    X(i8, 1, 1, ENCODE_I8)             \
+    X(ia4, 2, 1, ENCODE_IA4)           \
+    X(ia8, 1, 1, ENCODE_IA8)           \
+    X(ia16, 1, 2, ENCODE_IA16)
+
+// Color indexed formats copy the row bytes as indices, whatever the layout, but 4 bit indices
+#define PNG_TEXTURE_INDEXED_ENCODERS(X) \
+    X(ci4, 2, 1, ENCODE_CI4)            \
+    X(ci8, 1, 1, ENCODE_CI8)
+
+typedef void (*PngTextureRowEncoder)(uint8_t* dst, const uint8_t* src, size_t width);
+
+#define DEFINE_ROW_ENCODER(type, layout, bpp, px, pixelsPerStep, bytesPerStep, encode)                  \
+    static void PngTexture_Encode_##type##_##layout(uint8_t* dst, const uint8_t* src, size_t width) { \
+        for (size_t x = 0; x < width; x += (pixelsPerStep)) {                                          \
+            encode(dst, src, bpp, px);                                                                \
+            dst += (bytesPerStep);                                                                    \
+            src += (bpp) * (pixelsPerStep);                                                           \
+        }                                                                                             \
+    }
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            size_t pos = ((y * width) + x) * 2;
-            RGBAPixel pixel = ImageBackend_GetPixel(textureData, y, x);
+#define DEFINE_DIRECT_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                   \
+    DEFINE_ROW_ENCODER(type, rgb, 3, PIXEL_RGB, pixelsPerStep, bytesPerStep, encode)       \
+    DEFINE_ROW_ENCODER(type, rgba, 4, PIXEL_RGBA, pixelsPerStep, bytesPerStep, encode)     \
+    DEFINE_ROW_ENCODER(type, gray, 1, PIXEL_GRAY, pixelsPerStep, bytesPerStep, encode)     \
+    DEFINE_ROW_ENCODER(type, graya, 2, PIXEL_GRAYA, pixelsPerStep, bytesPerStep, encode)
 
-            uint8_t r = pixel.r / 8;
-            uint8_t g = pixel.g / 8;
-            uint8_t b = pixel.b / 8;
+#define DEFINE_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) \
+    DEFINE_ROW_ENCODER(type, indexed, 1, PIXEL_GRAY, pixelsPerStep, bytesPerStep, encode)
 
-            uint8_t alphaBit = pixel.a != 0;
+PNG_TEXTURE_DIRECT_ENCODERS(DEFINE_DIRECT_ENCODERS)
+PNG_TEXTURE_INDEXED_ENCODERS(DEFINE_INDEXED_ENCODERS)
 
-            uint16_t data = (r << 11) + (g << 6) + (b << 1) + alphaBit;
+// 4 bit palette pngs are ci4 already
+static void PngTexture_Encode_ci4_indexed4(uint8_t* dst, const uint8_t* src, size_t width) {
+    memcpy(dst, src, width / 2);
+}
 
-            dst->buffer[pos + 0] = (data & 0xFF00) >> 8;
-            dst->buffer[pos + 1] = (data & 0x00FF);
-        }
+static void PngTexture_Encode_ci8_indexed4(uint8_t* dst, const uint8_t* src, size_t width) {
+    size_t x = 0;
+
+    for (; x + 2 <= width; x += 2) {
+        dst[x + 0] = src[x / 2] >> 4;
+        dst[x + 1] = src[x / 2] & 0xF;
+    }
+    if (x < width) {
+        dst[x] = src[x / 2] >> 4;
     }
 }
 
-void PngTexture_CopyRgba32(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
-
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            size_t pos = ((y * width) + x) * 4;
-            RGBAPixel pixel = ImageBackend_GetPixel(textureData, y, x);
+#define DIRECT_ENCODER_ENTRY(type, pixelsPerStep, bytesPerStep, encode) \
+    [TextureType_##type] = {                                            \
+        [ImageLayout_RGB] = PngTexture_Encode_##type##_rgb,             \
+        [ImageLayout_RGBA] = PngTexture_Encode_##type##_rgba,           \
+        [ImageLayout_Gray] = PngTexture_Encode_##type##_gray,           \
+        [ImageLayout_GrayAlpha] = PngTexture_Encode_##type##_graya,     \
+    },
+
+#define INDEXED_ENCODER_ENTRY(type, pixelsPerStep, bytesPerStep, encode) \
+    [TextureType_##type] = {                                             \
+        [ImageLayout_RGB] = PngTexture_Encode_##type##_indexed,          \
+        [ImageLayout_RGBA] = PngTexture_Encode_##type##_indexed,         \
+        [ImageLayout_Gray] = PngTexture_Encode_##type##_indexed,         \
+        [ImageLayout_GrayAlpha] = PngTexture_Encode_##type##_indexed,    \
+        [ImageLayout_Indexed] = PngTexture_Encode_##type##_indexed,      \
+        [ImageLayout_Indexed4] = PngTexture_Encode_##type##_indexed4,    \
+    },
+
+// NULL where the conversion makes no sense, i.e. a direct color format from a color indexed image
+static const PngTextureRowEncoder sScalarRowEncoders[TextureType_Max][ImageLayout_Max] = {
+    PNG_TEXTURE_DIRECT_ENCODERS(DIRECT_ENCODER_ENTRY) PNG_TEXTURE_INDEXED_ENCODERS(INDEXED_ENCODER_ENTRY)
+};
 
-            dst->buffer[pos + 0] = pixel.r;
-            dst->buffer[pos + 1] = pixel.g;
-            dst->buffer[pos + 2] = pixel.b;
-            dst->buffer[pos + 3] = pixel.a;
-        }
+/* SIMD encoders */
+
+// The vector encoders load a run of pixels as one vector per channel (r, g, b, a, 0 without alpha) and store them in
+// the texture format, with the same math as the scalar encoders. The pixels left at the end of the row, fewer than a
+// vector, go through the scalar encoder once PngTexture_Leave_<isa> has cleaned up the vector state.
+#define DEFINE_SIMD_ROW_ENCODER(type, layout, isa, target, vec, pixels, bpp, load, pixelsPerStep, bytesPerStep)       \
+    target static void PngTexture_Encode_##type##_##layout##_##isa(uint8_t* dst, const uint8_t* src, size_t width) { \
+        size_t x = 0;                                                                                             \
+        for (; x + (pixels) <= width; x += (pixels)) {                                                            \
+            vec r, g, b, a;                                                                                       \
+            load(&src[x * (bpp)], &r, &g, &b, &a);                                                                \
+            PngTexture_Store_##type##_##isa(&dst[x / (pixelsPerStep) * (bytesPerStep)], r, g, b, a);              \
+        }                                                                                                         \
+        PngTexture_Leave_##isa();                                                                                 \
+        PngTexture_Encode_##type##_##layout(&dst[x / (pixelsPerStep) * (bytesPerStep)], &src[x * (bpp)], width - x); \
     }
+
+typedef enum PngTextureIsa {
+    PngTextureIsa_Scalar,
+    PngTextureIsa_Sse2,
+    PngTextureIsa_Ssse3,
+    PngTextureIsa_Avx2,
+    PngTextureIsa_Neon,
+    PngTextureIsa_Max,
+} PngTextureIsa;
+
+static const char* sIsaNames[PngTextureIsa_Max] = {
+    [PngTextureIsa_Scalar] = "scalar", [PngTextureIsa_Sse2] = "sse2", [PngTextureIsa_Ssse3] = "ssse3",
+    [PngTextureIsa_Avx2] = "avx2",     [PngTextureIsa_Neon] = "neon",
+};
+
+#define SIMD_INLINE static inline __attribute__((always_inline))
+
+#ifdef PNG_TEXTURE_X86_SIMD
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/* SSE2, 16 pixels at a time */
+
+// 64 bytes of rgba, every 32 bit lane is one pixel
+SIMD_INLINE SSE2_TARGET void PngTexture_LoadRgba_sse2(const uint8_t* src, __m128i* r, __m128i* g, __m128i* b,
+                                                      __m128i* a) {
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i p0 = _mm_loadu_si128((const __m128i*)&src[0]);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)&src[16]);
+    __m128i p2 = _mm_loadu_si128((const __m128i*)&src[32]);
+    __m128i p3 = _mm_loadu_si128((const __m128i*)&src[48]);
+
+#define SSE2_CHANNEL(shift)                                                                              \
+    _mm_packus_epi16(_mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, shift), mask),                     \
+                                     _mm_and_si128(_mm_srli_epi32(p1, shift), mask)),                    \
+                     _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p2, shift), mask),                     \
+                                     _mm_and_si128(_mm_srli_epi32(p3, shift), mask)))
+    *r = SSE2_CHANNEL(0);
+    *g = SSE2_CHANNEL(8);
+    *b = SSE2_CHANNEL(16);
+    *a = SSE2_CHANNEL(24);
+#undef SSE2_CHANNEL
 }
 
-void PngTexture_CopyI4(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+// 16 bytes of gray
+SIMD_INLINE SSE2_TARGET void PngTexture_LoadGray_sse2(const uint8_t* src, __m128i* r, __m128i* g, __m128i* b,
+                                                      __m128i* a) {
+    *r = *g = *b = _mm_loadu_si128((const __m128i*)src);
+    *a = _mm_setzero_si128();
+}
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x += 2) {
-            size_t pos = ((y * width) + x) / 2;
-            uint8_t r1 = ImageBackend_GetPixel(textureData, y, x).r;
-            uint8_t r2 = ImageBackend_GetPixel(textureData, y, x + 1).r;
+// 32 bytes of gray + alpha, every 16 bit lane is one pixel
+SIMD_INLINE SSE2_TARGET void PngTexture_LoadGrayAlpha_sse2(const uint8_t* src, __m128i* r, __m128i* g, __m128i* b,
+                                                           __m128i* a) {
+    __m128i mask = _mm_set1_epi16(0xFF);
+    __m128i p0 = _mm_loadu_si128((const __m128i*)&src[0]);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)&src[16]);
 
-            dst->buffer[pos] = (uint8_t)(((r1 / 16) << 4) + (r2 / 16));
-        }
-    }
+    *r = *g = *b = _mm_packus_epi16(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    *a = _mm_packus_epi16(_mm_srli_epi16(p0, 8), _mm_srli_epi16(p1, 8));
 }
 
-void PngTexture_CopyI8(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+// 16 bytes of color indices, only r is used
+SIMD_INLINE SSE2_TARGET void PngTexture_LoadIndices_sse2(const uint8_t* src, __m128i* r, __m128i* g, __m128i* b,
+                                                         __m128i* a) {
+    *r = _mm_loadu_si128((const __m128i*)src);
+    *g = *b = *a = _mm_setzero_si128();
+}
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            size_t pos = (y * width) + x;
-            RGBAPixel pixel = ImageBackend_GetPixel(textureData, y, x);
-            dst->buffer[pos] = pixel.r;
-        }
-    }
+// 0 where the alpha is 0, 1 elsewhere
+SIMD_INLINE SSE2_TARGET __m128i PngTexture_AlphaBit_sse2(__m128i a) {
+    return _mm_andnot_si128(_mm_cmpeq_epi8(a, _mm_setzero_si128()), _mm_set1_epi8(1));
 }
 
-void PngTexture_CopyIA4(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+// Two 4 bit pixels per byte: every 16 bit lane holds a pair, first pixel in the low byte. The high nibble of the
+// result is the low nibble of the first pixel, the low nibble is the second pixel
+SIMD_INLINE SSE2_TARGET __m128i PngTexture_PackNibbles_sse2(__m128i pairs) {
+    return _mm_or_si128(_mm_and_si128(_mm_slli_epi16(pairs, 4), _mm_set1_epi16(0xF0)), _mm_srli_epi16(pairs, 8));
+}
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x += 2) {
-            size_t pos = ((y * width) + x) / 2;
-            uint8_t data = 0;
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_rgba16_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    // high byte: rrrrrggg, low byte: ggbbbbba
+    __m128i hi = _mm_or_si128(_mm_and_si128(r, _mm_set1_epi8((char)0xF8)),
+                              _mm_and_si128(_mm_srli_epi16(g, 5), _mm_set1_epi8(0x07)));
+    __m128i lo = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi16(g, 3), _mm_set1_epi8((char)0xC0)),
+                                           _mm_and_si128(_mm_srli_epi16(b, 2), _mm_set1_epi8(0x3E))),
+                              PngTexture_AlphaBit_sse2(a));
 
-            for (uint16_t i = 0; i < 2; i++) {
-                RGBAPixel pixel = ImageBackend_GetPixel(textureData, y, x + i);
-                uint8_t cR = pixel.r;
-                uint8_t alphaBit = pixel.a != 0;
+    _mm_storeu_si128((__m128i*)&dst[0], _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)&dst[16], _mm_unpackhi_epi8(hi, lo));
+}
 
-                if (i == 0)
-                    data |= (((cR / 32) << 1) + alphaBit) << 4;
-                else
-                    data |= ((cR / 32) << 1) + alphaBit;
-            }
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_rgba32_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    __m128i rgLo = _mm_unpacklo_epi8(r, g);
+    __m128i rgHi = _mm_unpackhi_epi8(r, g);
+    __m128i baLo = _mm_unpacklo_epi8(b, a);
+    __m128i baHi = _mm_unpackhi_epi8(b, a);
 
-            dst->buffer[pos] = data;
-        }
-    }
+    _mm_storeu_si128((__m128i*)&dst[0], _mm_unpacklo_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i*)&dst[16], _mm_unpackhi_epi16(rgLo, baLo));
+    _mm_storeu_si128((__m128i*)&dst[32], _mm_unpacklo_epi16(rgHi, baHi));
+    _mm_storeu_si128((__m128i*)&dst[48], _mm_unpackhi_epi16(rgHi, baHi));
 }
 
-void PngTexture_CopyIA8(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_i4_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b, (void)a;
+    __m128i pairs = _mm_srli_epi16(_mm_and_si128(r, _mm_set1_epi8((char)0xF0)), 4);
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            size_t pos = ((y * width) + x) * 1;
-            RGBAPixel pixel = ImageBackend_GetPixel(textureData, y, x);
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(PngTexture_PackNibbles_sse2(pairs), pairs));
+}
 
-            uint8_t r = pixel.r;
-            uint8_t a = pixel.a;
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_i8_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b, (void)a;
+    _mm_storeu_si128((__m128i*)dst, r);
+}
 
-            dst->buffer[pos] = ((r / 16) << 4) + (a / 16);
-        }
-    }
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_ia4_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b;
+    // iiia per pixel
+    __m128i pairs = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(r, 4), _mm_set1_epi8(0x0E)), PngTexture_AlphaBit_sse2(a));
+
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(PngTexture_PackNibbles_sse2(pairs), pairs));
 }
 
-void PngTexture_CopyIA16(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_ia8_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b;
+    _mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_and_si128(r, _mm_set1_epi8((char)0xF0)),
+                                                 _mm_and_si128(_mm_srli_epi16(a, 4), _mm_set1_epi8(0x0F))));
+}
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            size_t pos = ((y * width) + x) * 2;
-            RGBAPixel pixel = ImageBackend_GetPixel(textureData, y, x);
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_ia16_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b;
+    _mm_storeu_si128((__m128i*)&dst[0], _mm_unpacklo_epi8(r, a));
+    _mm_storeu_si128((__m128i*)&dst[16], _mm_unpackhi_epi8(r, a));
+}
 
-            uint8_t cR = pixel.r;
-            uint8_t aR = pixel.a;
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_ci4_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b, (void)a;
+    __m128i packed = PngTexture_PackNibbles_sse2(r);
 
-            dst->buffer[pos + 0] = cR;
-            dst->buffer[pos + 1] = aR;
-        }
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(packed, packed));
+}
+
+SIMD_INLINE SSE2_TARGET void PngTexture_Store_ci8_sse2(uint8_t* dst, __m128i r, __m128i g, __m128i b, __m128i a) {
+    (void)g, (void)b, (void)a;
+    _mm_storeu_si128((__m128i*)dst, r);
+}
+
+/* SSSE3, adds rgb input */
+
+// 48 bytes of rgb. Channel c of pixel i is byte 3 * i + c, which pshufb gathers out of the three vectors
+SIMD_INLINE SSSE3_TARGET void PngTexture_LoadRgb_ssse3(const uint8_t* src, __m128i* r, __m128i* g, __m128i* b,
+                                                       __m128i* a) {
+    __m128i p0 = _mm_loadu_si128((const __m128i*)&src[0]);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)&src[16]);
+    __m128i p2 = _mm_loadu_si128((const __m128i*)&src[32]);
+
+    *r = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(p0, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(p1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(p2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    *g = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(p0, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(p1, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(p2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    *b = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(p0, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+                     _mm_shuffle_epi8(p1, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(p2, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+    *a = _mm_setzero_si128();
+}
+
+SIMD_INLINE SSE2_TARGET void PngTexture_Leave_sse2(void) {
+}
+
+SIMD_INLINE SSSE3_TARGET void PngTexture_Leave_ssse3(void) {
+}
+
+// the stores are SSE2, the ssse3 names let DEFINE_SIMD_ROW_ENCODER find them
+#define PNG_TEXTURE_SSSE3_STORE(type, pixelsPerStep, bytesPerStep, encode)                                       \
+    SIMD_INLINE SSSE3_TARGET void PngTexture_Store_##type##_ssse3(uint8_t* dst, __m128i r, __m128i g, __m128i b, \
+                                                                  __m128i a) {                                  \
+        PngTexture_Store_##type##_sse2(dst, r, g, b, a);                                                         \
     }
+
+PNG_TEXTURE_DIRECT_ENCODERS(PNG_TEXTURE_SSSE3_STORE)
+
+/* AVX2, 32 pixels at a time */
+
+// 128 bytes of rgba. The packs work within each 128 bit half, which leaves groups of 4 pixels in the order
+// 0 2 4 6 1 3 5 7, put back in order by the permute
+SIMD_INLINE AVX2_TARGET void PngTexture_LoadRgba_avx2(const uint8_t* src, __m256i* r, __m256i* g, __m256i* b,
+                                                      __m256i* a) {
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    __m256i p0 = _mm256_loadu_si256((const __m256i*)&src[0]);
+    __m256i p1 = _mm256_loadu_si256((const __m256i*)&src[32]);
+    __m256i p2 = _mm256_loadu_si256((const __m256i*)&src[64]);
+    __m256i p3 = _mm256_loadu_si256((const __m256i*)&src[96]);
+
+#define AVX2_CHANNEL(shift)                                                                                     \
+    _mm256_permutevar8x32_epi32(                                                                                \
+        _mm256_packus_epi16(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, shift), mask),            \
+                                               _mm256_and_si256(_mm256_srli_epi32(p1, shift), mask)),           \
+                            _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p2, shift), mask),            \
+                                               _mm256_and_si256(_mm256_srli_epi32(p3, shift), mask))),          \
+        order)
+    *r = AVX2_CHANNEL(0);
+    *g = AVX2_CHANNEL(8);
+    *b = AVX2_CHANNEL(16);
+    *a = AVX2_CHANNEL(24);
+#undef AVX2_CHANNEL
 }
 
-void PngTexture_CopyCI4(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+// 96 bytes of rgb, as two SSSE3 loads, since pshufb can't cross the 128 bit halves
+SIMD_INLINE AVX2_TARGET void PngTexture_LoadRgb_avx2(const uint8_t* src, __m256i* r, __m256i* g, __m256i* b,
+                                                     __m256i* a) {
+    __m128i r0, g0, b0, a0;
+    __m128i r1, g1, b1, a1;
+
+    PngTexture_LoadRgb_ssse3(&src[0], &r0, &g0, &b0, &a0);
+    PngTexture_LoadRgb_ssse3(&src[48], &r1, &g1, &b1, &a1);
+    *r = _mm256_inserti128_si256(_mm256_castsi128_si256(r0), r1, 1);
+    *g = _mm256_inserti128_si256(_mm256_castsi128_si256(g0), g1, 1);
+    *b = _mm256_inserti128_si256(_mm256_castsi128_si256(b0), b1, 1);
+    *a = _mm256_setzero_si256();
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_LoadGray_avx2(const uint8_t* src, __m256i* r, __m256i* g, __m256i* b,
+                                                      __m256i* a) {
+    *r = *g = *b = _mm256_loadu_si256((const __m256i*)src);
+    *a = _mm256_setzero_si256();
+}
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x += 2) {
-            size_t pos = ((y * width) + x) / 2;
+// 64 bytes of gray + alpha. The packs leave groups of 8 pixels in the order 0 2 1 3
+SIMD_INLINE AVX2_TARGET void PngTexture_LoadGrayAlpha_avx2(const uint8_t* src, __m256i* r, __m256i* g, __m256i* b,
+                                                           __m256i* a) {
+    __m256i mask = _mm256_set1_epi16(0xFF);
+    __m256i p0 = _mm256_loadu_si256((const __m256i*)&src[0]);
+    __m256i p1 = _mm256_loadu_si256((const __m256i*)&src[32]);
 
-            uint8_t cR1 = ImageBackend_GetIndexedPixel(textureData, y, x);
-            uint8_t cR2 = ImageBackend_GetIndexedPixel(textureData, y, x + 1);
+    *r = *g = *b = _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask)), 0xD8);
+    *a = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(p0, 8), _mm256_srli_epi16(p1, 8)), 0xD8);
+}
 
-            dst->buffer[pos] = (cR1 << 4) | (cR2);
-        }
+SIMD_INLINE AVX2_TARGET void PngTexture_LoadIndices_avx2(const uint8_t* src, __m256i* r, __m256i* g, __m256i* b,
+                                                         __m256i* a) {
+    *r = _mm256_loadu_si256((const __m256i*)src);
+    *g = *b = *a = _mm256_setzero_si256();
+}
+
+SIMD_INLINE AVX2_TARGET __m256i PngTexture_AlphaBit_avx2(__m256i a) {
+    return _mm256_andnot_si256(_mm256_cmpeq_epi8(a, _mm256_setzero_si256()), _mm256_set1_epi8(1));
+}
+
+// see PngTexture_PackNibbles_sse2, the 16 result bytes are in order in the low half
+SIMD_INLINE AVX2_TARGET __m256i PngTexture_PackNibbles_avx2(__m256i pairs) {
+    __m256i packed = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(pairs, 4), _mm256_set1_epi16(0xF0)),
+                                     _mm256_srli_epi16(pairs, 8));
+
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(packed, packed), 0xD8);
+}
+
+// unpacklo/hi interleave within each 128 bit half, i.e. pixels 0-7 and 16-23, then 8-15 and 24-31
+SIMD_INLINE AVX2_TARGET void PngTexture_StoreInterleaved_avx2(uint8_t* dst, __m256i x, __m256i y) {
+    __m256i lo = _mm256_unpacklo_epi8(x, y);
+    __m256i hi = _mm256_unpackhi_epi8(x, y);
+
+    _mm256_storeu_si256((__m256i*)&dst[0], _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256((__m256i*)&dst[32], _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_rgba16_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    __m256i hi = _mm256_or_si256(_mm256_and_si256(r, _mm256_set1_epi8((char)0xF8)),
+                                 _mm256_and_si256(_mm256_srli_epi16(g, 5), _mm256_set1_epi8(0x07)));
+    __m256i lo = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(_mm256_slli_epi16(g, 3), _mm256_set1_epi8((char)0xC0)),
+                                                 _mm256_and_si256(_mm256_srli_epi16(b, 2), _mm256_set1_epi8(0x3E))),
+                                 PngTexture_AlphaBit_avx2(a));
+
+    PngTexture_StoreInterleaved_avx2(dst, hi, lo);
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_rgba32_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    __m256i rgLo = _mm256_unpacklo_epi8(r, g);
+    __m256i rgHi = _mm256_unpackhi_epi8(r, g);
+    __m256i baLo = _mm256_unpacklo_epi8(b, a);
+    __m256i baHi = _mm256_unpackhi_epi8(b, a);
+    // pixels 0-3 and 16-19, 4-7 and 20-23, 8-11 and 24-27, 12-15 and 28-31
+    __m256i q0 = _mm256_unpacklo_epi16(rgLo, baLo);
+    __m256i q1 = _mm256_unpackhi_epi16(rgLo, baLo);
+    __m256i q2 = _mm256_unpacklo_epi16(rgHi, baHi);
+    __m256i q3 = _mm256_unpackhi_epi16(rgHi, baHi);
+
+    _mm256_storeu_si256((__m256i*)&dst[0], _mm256_permute2x128_si256(q0, q1, 0x20));
+    _mm256_storeu_si256((__m256i*)&dst[32], _mm256_permute2x128_si256(q2, q3, 0x20));
+    _mm256_storeu_si256((__m256i*)&dst[64], _mm256_permute2x128_si256(q0, q1, 0x31));
+    _mm256_storeu_si256((__m256i*)&dst[96], _mm256_permute2x128_si256(q2, q3, 0x31));
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_i4_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b, (void)a;
+    __m256i pairs = _mm256_srli_epi16(_mm256_and_si256(r, _mm256_set1_epi8((char)0xF0)), 4);
+
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(PngTexture_PackNibbles_avx2(pairs)));
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_i8_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b, (void)a;
+    _mm256_storeu_si256((__m256i*)dst, r);
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_ia4_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b;
+    __m256i pairs = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(r, 4), _mm256_set1_epi8(0x0E)),
+                                    PngTexture_AlphaBit_avx2(a));
+
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(PngTexture_PackNibbles_avx2(pairs)));
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_ia8_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b;
+    _mm256_storeu_si256((__m256i*)dst,
+                        _mm256_or_si256(_mm256_and_si256(r, _mm256_set1_epi8((char)0xF0)),
+                                        _mm256_and_si256(_mm256_srli_epi16(a, 4), _mm256_set1_epi8(0x0F))));
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_ia16_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b;
+    PngTexture_StoreInterleaved_avx2(dst, r, a);
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_ci4_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b, (void)a;
+    _mm_storeu_si128((__m128i*)dst, _mm256_castsi256_si128(PngTexture_PackNibbles_avx2(r)));
+}
+
+SIMD_INLINE AVX2_TARGET void PngTexture_Store_ci8_avx2(uint8_t* dst, __m256i r, __m256i g, __m256i b, __m256i a) {
+    (void)g, (void)b, (void)a;
+    _mm256_storeu_si256((__m256i*)dst, r);
+}
+
+// gcc doesn't clear the upper halves of the registers for functions with a target attribute, and leaving them dirty
+// slows down every SSE instruction after the encoder, in libpng and zlib too
+SIMD_INLINE AVX2_TARGET void PngTexture_Leave_avx2(void) {
+    _mm256_zeroupper();
+}
+
+#define DEFINE_SSE2_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                                       \
+    DEFINE_SIMD_ROW_ENCODER(type, rgba, sse2, SSE2_TARGET, __m128i, 16, 4, PngTexture_LoadRgba_sse2, pixelsPerStep, \
+                            bytesPerStep)                                                                     \
+    DEFINE_SIMD_ROW_ENCODER(type, gray, sse2, SSE2_TARGET, __m128i, 16, 1, PngTexture_LoadGray_sse2, pixelsPerStep, \
+                            bytesPerStep)                                                                     \
+    DEFINE_SIMD_ROW_ENCODER(type, graya, sse2, SSE2_TARGET, __m128i, 16, 2, PngTexture_LoadGrayAlpha_sse2,         \
+                            pixelsPerStep, bytesPerStep)
+#define DEFINE_SSE2_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                           \
+    DEFINE_SIMD_ROW_ENCODER(type, indexed, sse2, SSE2_TARGET, __m128i, 16, 1, PngTexture_LoadIndices_sse2, \
+                            pixelsPerStep, bytesPerStep)
+#define DEFINE_SSSE3_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                                       \
+    DEFINE_SIMD_ROW_ENCODER(type, rgb, ssse3, SSSE3_TARGET, __m128i, 16, 3, PngTexture_LoadRgb_ssse3, pixelsPerStep, \
+                            bytesPerStep)
+#define DEFINE_AVX2_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                                       \
+    DEFINE_SIMD_ROW_ENCODER(type, rgba, avx2, AVX2_TARGET, __m256i, 32, 4, PngTexture_LoadRgba_avx2, pixelsPerStep, \
+                            bytesPerStep)                                                                     \
+    DEFINE_SIMD_ROW_ENCODER(type, rgb, avx2, AVX2_TARGET, __m256i, 32, 3, PngTexture_LoadRgb_avx2, pixelsPerStep,   \
+                            bytesPerStep)                                                                     \
+    DEFINE_SIMD_ROW_ENCODER(type, gray, avx2, AVX2_TARGET, __m256i, 32, 1, PngTexture_LoadGray_avx2, pixelsPerStep, \
+                            bytesPerStep)                                                                     \
+    DEFINE_SIMD_ROW_ENCODER(type, graya, avx2, AVX2_TARGET, __m256i, 32, 2, PngTexture_LoadGrayAlpha_avx2,         \
+                            pixelsPerStep, bytesPerStep)
+#define DEFINE_AVX2_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                           \
+    DEFINE_SIMD_ROW_ENCODER(type, indexed, avx2, AVX2_TARGET, __m256i, 32, 1, PngTexture_LoadIndices_avx2, \
+                            pixelsPerStep, bytesPerStep)
+
+PNG_TEXTURE_DIRECT_ENCODERS(DEFINE_SSE2_ENCODERS)
+PNG_TEXTURE_INDEXED_ENCODERS(DEFINE_SSE2_INDEXED_ENCODERS)
+PNG_TEXTURE_DIRECT_ENCODERS(DEFINE_SSSE3_ENCODERS)
+PNG_TEXTURE_DIRECT_ENCODERS(DEFINE_AVX2_ENCODERS)
+PNG_TEXTURE_INDEXED_ENCODERS(DEFINE_AVX2_INDEXED_ENCODERS)
+#endif
+
+#ifdef PNG_TEXTURE_NEON
+#define NEON_TARGET
+
+/* NEON, 16 pixels at a time. vld3/vld4 deinterleave the channels themselves */
+
+SIMD_INLINE void PngTexture_LoadRgba_neon(const uint8_t* src, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b,
+                                          uint8x16_t* a) {
+    uint8x16x4_t pixels = vld4q_u8(src);
+
+    *r = pixels.val[0];
+    *g = pixels.val[1];
+    *b = pixels.val[2];
+    *a = pixels.val[3];
+}
+
+SIMD_INLINE void PngTexture_LoadRgb_neon(const uint8_t* src, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b,
+                                         uint8x16_t* a) {
+    uint8x16x3_t pixels = vld3q_u8(src);
+
+    *r = pixels.val[0];
+    *g = pixels.val[1];
+    *b = pixels.val[2];
+    *a = vdupq_n_u8(0);
+}
+
+SIMD_INLINE void PngTexture_LoadGray_neon(const uint8_t* src, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b,
+                                          uint8x16_t* a) {
+    *r = *g = *b = vld1q_u8(src);
+    *a = vdupq_n_u8(0);
+}
+
+SIMD_INLINE void PngTexture_LoadGrayAlpha_neon(const uint8_t* src, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b,
+                                               uint8x16_t* a) {
+    uint8x16x2_t pixels = vld2q_u8(src);
+
+    *r = *g = *b = pixels.val[0];
+    *a = pixels.val[1];
+}
+
+SIMD_INLINE void PngTexture_LoadIndices_neon(const uint8_t* src, uint8x16_t* r, uint8x16_t* g, uint8x16_t* b,
+                                             uint8x16_t* a) {
+    *r = vld1q_u8(src);
+    *g = *b = *a = vdupq_n_u8(0);
+}
+
+SIMD_INLINE uint8x16_t PngTexture_AlphaBit_neon(uint8x16_t a) {
+    return vandq_u8(vtstq_u8(a, a), vdupq_n_u8(1));
+}
+
+// 8 bytes of two 4 bit pixels, each the low nibble of its byte in pixels (the first pixel's is truncated)
+SIMD_INLINE uint8x8_t PngTexture_PackNibbles_neon(uint8x16_t pixels) {
+    uint8x16x2_t evenOdd = vuzpq_u8(pixels, pixels);
+
+    return vorr_u8(vshl_n_u8(vget_low_u8(evenOdd.val[0]), 4), vget_low_u8(evenOdd.val[1]));
+}
+
+SIMD_INLINE void PngTexture_Store_rgba16_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    uint8x16x2_t data;
+
+    // high byte: rrrrrggg, low byte: ggbbbbba
+    data.val[0] = vorrq_u8(vandq_u8(r, vdupq_n_u8(0xF8)), vshrq_n_u8(g, 5));
+    data.val[1] = vorrq_u8(vorrq_u8(vandq_u8(vshlq_n_u8(g, 3), vdupq_n_u8(0xC0)),
+                                    vandq_u8(vshrq_n_u8(b, 2), vdupq_n_u8(0x3E))),
+                           PngTexture_AlphaBit_neon(a));
+    vst2q_u8(dst, data);
+}
+
+SIMD_INLINE void PngTexture_Store_rgba32_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    uint8x16x4_t data;
+
+    data.val[0] = r;
+    data.val[1] = g;
+    data.val[2] = b;
+    data.val[3] = a;
+    vst4q_u8(dst, data);
+}
+
+SIMD_INLINE void PngTexture_Store_i4_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    (void)g, (void)b, (void)a;
+    vst1_u8(dst, PngTexture_PackNibbles_neon(vshrq_n_u8(r, 4)));
+}
+
+SIMD_INLINE void PngTexture_Store_i8_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    (void)g, (void)b, (void)a;
+    vst1q_u8(dst, r);
+}
+
+SIMD_INLINE void PngTexture_Store_ia4_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    (void)g, (void)b;
+    vst1_u8(dst, PngTexture_PackNibbles_neon(
+                     vorrq_u8(vandq_u8(vshrq_n_u8(r, 4), vdupq_n_u8(0x0E)), PngTexture_AlphaBit_neon(a))));
+}
+
+SIMD_INLINE void PngTexture_Store_ia8_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    (void)g, (void)b;
+    vst1q_u8(dst, vorrq_u8(vandq_u8(r, vdupq_n_u8(0xF0)), vshrq_n_u8(a, 4)));
+}
+
+SIMD_INLINE void PngTexture_Store_ia16_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    uint8x16x2_t data;
+
+    (void)g, (void)b;
+    data.val[0] = r;
+    data.val[1] = a;
+    vst2q_u8(dst, data);
+}
+
+SIMD_INLINE void PngTexture_Store_ci4_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    (void)g, (void)b, (void)a;
+    vst1_u8(dst, PngTexture_PackNibbles_neon(r));
+}
+
+SIMD_INLINE void PngTexture_Store_ci8_neon(uint8_t* dst, uint8x16_t r, uint8x16_t g, uint8x16_t b, uint8x16_t a) {
+    (void)g, (void)b, (void)a;
+    vst1q_u8(dst, r);
+}
+
+SIMD_INLINE void PngTexture_Leave_neon(void) {
+}
+
+#define DEFINE_NEON_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                                        \
+    DEFINE_SIMD_ROW_ENCODER(type, rgba, neon, NEON_TARGET, uint8x16_t, 16, 4, PngTexture_LoadRgba_neon,        \
+                            pixelsPerStep, bytesPerStep)                                                       \
+    DEFINE_SIMD_ROW_ENCODER(type, rgb, neon, NEON_TARGET, uint8x16_t, 16, 3, PngTexture_LoadRgb_neon, pixelsPerStep, \
+                            bytesPerStep)                                                                      \
+    DEFINE_SIMD_ROW_ENCODER(type, gray, neon, NEON_TARGET, uint8x16_t, 16, 1, PngTexture_LoadGray_neon,         \
+                            pixelsPerStep, bytesPerStep)                                                       \
+    DEFINE_SIMD_ROW_ENCODER(type, graya, neon, NEON_TARGET, uint8x16_t, 16, 2, PngTexture_LoadGrayAlpha_neon,   \
+                            pixelsPerStep, bytesPerStep)
+#define DEFINE_NEON_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode)                              \
+    DEFINE_SIMD_ROW_ENCODER(type, indexed, neon, NEON_TARGET, uint8x16_t, 16, 1, PngTexture_LoadIndices_neon, \
+                            pixelsPerStep, bytesPerStep)
+
+PNG_TEXTURE_DIRECT_ENCODERS(DEFINE_NEON_ENCODERS)
+PNG_TEXTURE_INDEXED_ENCODERS(DEFINE_NEON_INDEXED_ENCODERS)
+#endif
+
+static bool PngTexture_IsaSupported(PngTextureIsa isa) {
+    switch (isa) {
+        case PngTextureIsa_Scalar:
+            return true;
+
+#ifdef PNG_TEXTURE_X86_SIMD
+        case PngTextureIsa_Sse2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2");
+
+        case PngTextureIsa_Ssse3:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3");
+
+        case PngTextureIsa_Avx2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#endif
+
+#ifdef PNG_TEXTURE_NEON
+        case PngTextureIsa_Neon:
+            return true;
+#endif
+
+        default:
+            return false;
     }
 }
 
-void PngTexture_CopyCI8(GenericBuffer* dst, const ImageBackend* textureData) {
-    size_t width = textureData->width;
-    size_t height = textureData->height;
+// The encoders to use with isa: the scalar ones, replaced by the vector ones of isa and of the ISAs it extends
+static void PngTexture_GetRowEncoders(PngTextureRowEncoder encoders[TextureType_Max][ImageLayout_Max],
+                                      PngTextureIsa isa) {
+    memcpy(encoders, sScalarRowEncoders, sizeof(sScalarRowEncoders));
+    (void)isa;
+
+#define SET_ENCODER(type, layout, enumLayout, isaName) \
+    encoders[TextureType_##type][ImageLayout_##enumLayout] = PngTexture_Encode_##type##_##layout##_##isaName;
+#define SET_INDEXED_ENCODERS(type, isaName)          \
+    SET_ENCODER(type, indexed, RGB, isaName)         \
+    SET_ENCODER(type, indexed, RGBA, isaName)        \
+    SET_ENCODER(type, indexed, Gray, isaName)        \
+    SET_ENCODER(type, indexed, GrayAlpha, isaName)   \
+    SET_ENCODER(type, indexed, Indexed, isaName)
+#define SET_DIRECT_ENCODERS(type, isaName)           \
+    SET_ENCODER(type, rgba, RGBA, isaName)           \
+    SET_ENCODER(type, rgb, RGB, isaName)             \
+    SET_ENCODER(type, gray, Gray, isaName)           \
+    SET_ENCODER(type, graya, GrayAlpha, isaName)
+
+#ifdef PNG_TEXTURE_X86_SIMD
+#define SET_SSE2_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) \
+    SET_ENCODER(type, rgba, RGBA, sse2)                             \
+    SET_ENCODER(type, gray, Gray, sse2)                             \
+    SET_ENCODER(type, graya, GrayAlpha, sse2)
+#define SET_SSE2_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) SET_INDEXED_ENCODERS(type, sse2)
+#define SET_SSSE3_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) SET_ENCODER(type, rgb, RGB, ssse3)
+#define SET_AVX2_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) SET_DIRECT_ENCODERS(type, avx2)
+#define SET_AVX2_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) SET_INDEXED_ENCODERS(type, avx2)
+
+    if (isa >= PngTextureIsa_Sse2 && isa <= PngTextureIsa_Avx2) {
+        PNG_TEXTURE_DIRECT_ENCODERS(SET_SSE2_ENCODERS)
+        PNG_TEXTURE_INDEXED_ENCODERS(SET_SSE2_INDEXED_ENCODERS)
+    }
+    if (isa >= PngTextureIsa_Ssse3 && isa <= PngTextureIsa_Avx2) {
+        PNG_TEXTURE_DIRECT_ENCODERS(SET_SSSE3_ENCODERS)
+    }
+    if (isa == PngTextureIsa_Avx2) {
+        PNG_TEXTURE_DIRECT_ENCODERS(SET_AVX2_ENCODERS)
+        PNG_TEXTURE_INDEXED_ENCODERS(SET_AVX2_INDEXED_ENCODERS)
+    }
+#endif
 
-    for (uint16_t y = 0; y < height; y++) {
-        for (uint16_t x = 0; x < width; x++) {
-            size_t pos = ((y * width) + x);
-            uint8_t cR = ImageBackend_GetIndexedPixel(textureData, y, x);
+#ifdef PNG_TEXTURE_NEON
+#define SET_NEON_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) SET_DIRECT_ENCODERS(type, neon)
+#define SET_NEON_INDEXED_ENCODERS(type, pixelsPerStep, bytesPerStep, encode) SET_INDEXED_ENCODERS(type, neon)
 
-            dst->buffer[pos] = cR;
-        }
+    if (isa == PngTextureIsa_Neon) {
+        PNG_TEXTURE_DIRECT_ENCODERS(SET_NEON_ENCODERS)
+        PNG_TEXTURE_INDEXED_ENCODERS(SET_NEON_INDEXED_ENCODERS)
     }
+#endif
 }
 
-typedef void (*CopyPngCallbacks)(GenericBuffer* dst, const ImageBackend* textureData);
+static PngTextureRowEncoder sRowEncoders[TextureType_Max][ImageLayout_Max];
+static bool sRowEncodersSelected = false;
 
-CopyPngCallbacks readPngArray[TextureType_Max] = {
-    [TextureType_rgba16] = PngTexture_CopyRgba16, [TextureType_rgba32] = PngTexture_CopyRgba32,
-    [TextureType_i4] = PngTexture_CopyI4,         [TextureType_i8] = PngTexture_CopyI8,
-    [TextureType_ia4] = PngTexture_CopyIA4,       [TextureType_ia8] = PngTexture_CopyIA8,
-    [TextureType_ia16] = PngTexture_CopyIA16,     [TextureType_ci4] = PngTexture_CopyCI4,
-    [TextureType_ci8] = PngTexture_CopyCI8,
-};
+// picks the widest vector encoders the cpu we run on supports, the first time a texture is encoded.
+// Textures are encoded on the main thread only
+static void PngTexture_SelectRowEncoders(void) {
+    if (sRowEncodersSelected) {
+        return;
+    }
+
+    PngTextureIsa best = PngTextureIsa_Scalar;
+    for (PngTextureIsa isa = PngTextureIsa_Scalar; isa < PngTextureIsa_Max; isa++) {
+        if (PngTexture_IsaSupported(isa)) {
+            best = isa;
+        }
+    }
+
+    PngTexture_GetRowEncoders(sRowEncoders, best);
+    sRowEncodersSelected = true;
+}
 
 void PngTexture_CopyPng(GenericBuffer* dst, const ImageBackend* textureData, TextureType texType) {
     assert(dst != NULL);
@@ -182,11 +816,42 @@ void PngTexture_CopyPng(GenericBuffer* dst, const ImageBackend* textureData, Tex
     // TODO?
     assert(!dst->hasData);
 
-    dst->bufferSize = textureData->width * textureData->height * PngTexture_BitsPerPixel(texType) / 8;
+    size_t width = textureData->width;
+    size_t height = textureData->height;
+    uint32_t bitsPerPixel = PngTexture_BitsPerPixel(texType);
+    // 4 bit formats encode pixel pairs, which must not straddle two rows
+    assert(bitsPerPixel % 8 == 0 || width % 2 == 0);
+
+    ImageLayout layout = ImageBackend_GetLayout(textureData);
+    assert(layout < ImageLayout_Max);
+    PngTexture_SelectRowEncoders();
+    PngTextureRowEncoder encoder = sRowEncoders[texType][layout];
+    assert(encoder != NULL);
+
+    size_t rowSize = width * bitsPerPixel / 8;
+    dst->bufferSize = rowSize * height;
     dst->bufferLength = dst->bufferSize;
     dst->buffer = calloc(dst->bufferSize, sizeof(uint8_t));
 
-    readPngArray[texType](dst, textureData);
+    // rows with nothing between them are encoded as one long row. The color indexed encoders read one byte per
+    // pixel whatever the layout, but 4 bit indices
+    bool contiguous;
+    if (layout == ImageLayout_Indexed4) {
+        contiguous = width % 2 == 0 && textureData->stride == width / 2;
+    } else if (texType == TextureType_ci4 || texType == TextureType_ci8) {
+        contiguous = textureData->stride == width;
+    } else {
+        contiguous = textureData->stride == width * (size_t)ImageBackend_GetBytesPerPixel(textureData);
+    }
+
+    if (height != 0 && contiguous) {
+        // e.g. RGBA8 with a width multiple of 4, or gray with a multiple of 16
+        encoder(dst->buffer, ImageBackend_GetRow(textureData, 0), width * height);
+    } else {
+        for (size_t y = 0; y < height; y++) {
+            encoder(&dst->buffer[y * rowSize], ImageBackend_GetSpan(textureData, y, 0, width), width);
+        }
+    }
 
     dst->hasData = true;
 }
@@ -201,25 +866,116 @@ void PngTexture_CopyPalette(GenericBuffer* dst, const ImageBackend* textureData)
     dst->bufferLength = dst->bufferSize;
     dst->buffer = calloc(dst->bufferSize, sizeof(uint8_t));
 
+    // the palette as one row of rgba pixels, for the rgba16 encoder
+    uint8_t row[ARRAY_COUNT(textureData->colorPalette) * 4];
     size_t paletteLen = textureData->paletteLen;
 
-    for (uint16_t i = 0; i < paletteLen; i++) {
-        size_t pos = i * 2;
+    for (size_t i = 0; i < paletteLen; i++) {
         RGBAPixel pixel = ImageBackend_GetPalettePixel(textureData, i);
 
-        uint8_t r = pixel.r / 8;
-        uint8_t g = pixel.g / 8;
-        uint8_t b = pixel.b / 8;
+        row[i * 4 + 0] = pixel.r;
+        row[i * 4 + 1] = pixel.g;
+        row[i * 4 + 2] = pixel.b;
+        row[i * 4 + 3] = pixel.a;
+    }
+
+    PngTexture_SelectRowEncoders();
+    sRowEncoders[TextureType_rgba16][ImageLayout_RGBA](dst->buffer, row, paletteLen);
+
+    dst->hasData = true;
+}
+
+static const char* sTextureTypeNames[TextureType_Max] = {
+    [TextureType_rgba16] = "rgba16", [TextureType_rgba32] = "rgba32", [TextureType_i4] = "i4",
+    [TextureType_i8] = "i8",         [TextureType_ia4] = "ia4",       [TextureType_ia8] = "ia8",
+    [TextureType_ia16] = "ia16",     [TextureType_ci4] = "ci4",       [TextureType_ci8] = "ci8",
+};
+
+static const char* sLayoutNames[ImageLayout_Max] = {
+    [ImageLayout_RGB] = "rgb",         [ImageLayout_RGBA] = "rgba",       [ImageLayout_Gray] = "gray",
+    [ImageLayout_GrayAlpha] = "graya", [ImageLayout_Indexed] = "indexed", [ImageLayout_Indexed4] = "indexed4",
+};
+
+#define SELF_CHECK_MAX_WIDTH 1024
+
+// small LCG, so the check is the same on every machine
+static uint32_t PngTexture_Random(uint32_t* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+// Encodes a random row of width pixels with both encoders and compares the bytes, including one past the end
+static bool PngTexture_CheckRow(PngTextureRowEncoder reference, PngTextureRowEncoder encoder, uint32_t bitsPerPixel,
+                                size_t width, uint32_t* seed) {
+    static uint8_t src[SELF_CHECK_MAX_WIDTH * 4];
+    static uint8_t expected[SELF_CHECK_MAX_WIDTH * 4 + 1];
+    static uint8_t actual[SELF_CHECK_MAX_WIDTH * 4 + 1];
+    size_t rowSize = width * bitsPerPixel / 8;
+
+    // mostly random, with plenty of 0 and 0xFF for the alpha bit
+    for (size_t i = 0; i < width * 4; i++) {
+        uint32_t value = PngTexture_Random(seed);
+
+        src[i] = (value & 0x300) == 0 ? 0x00 : (value & 0x300) == 0x100 ? 0xFF : (uint8_t)value;
+    }
+    memset(expected, 0xAA, rowSize + 1);
+    memset(actual, 0xAA, rowSize + 1);
+
+    reference(expected, src, width);
+    encoder(actual, src, width);
+    return memcmp(expected, actual, rowSize + 1) == 0;
+}
 
-        uint8_t alphaBit = pixel.a != 0;
+// Runs every vector encoder the cpu supports against the scalar one on random rows: every width up to a few vectors,
+// for the tails, then random widths. Prints a line per ISA, returns whether all of them matched
+bool PngTexture_SelfCheck(void) {
+    uint32_t seed = 1;
+    bool ok = true;
 
-        uint16_t data = (r << 11) + (g << 6) + (b << 1) + alphaBit;
+    for (PngTextureIsa isa = PngTextureIsa_Scalar + 1; isa < PngTextureIsa_Max; isa++) {
+        PngTextureRowEncoder encoders[TextureType_Max][ImageLayout_Max];
+        size_t checked = 0;
+        size_t failed = 0;
 
-        dst->buffer[pos + 0] = (data & 0xFF00) >> 8;
-        dst->buffer[pos + 1] = (data & 0x00FF);
+        if (!PngTexture_IsaSupported(isa)) {
+            continue;
+        }
+        PngTexture_GetRowEncoders(encoders, isa);
+
+        for (TextureType type = 0; type < TextureType_Max; type++) {
+            uint32_t bitsPerPixel = PngTexture_BitsPerPixel(type);
+
+            for (ImageLayout layout = 0; layout < ImageLayout_Max; layout++) {
+                PngTextureRowEncoder reference = sScalarRowEncoders[type][layout];
+                PngTextureRowEncoder encoder = encoders[type][layout];
+
+                if (encoder == reference) {
+                    continue;
+                }
+                checked++;
+
+                for (size_t i = 0; i < 256; i++) {
+                    size_t width = i < 128 ? i : PngTexture_Random(&seed) % (SELF_CHECK_MAX_WIDTH + 1);
+
+                    // 4 bit formats need whole pixel pairs
+                    if (bitsPerPixel % 8 != 0) {
+                        width &= ~(size_t)1;
+                    }
+                    if (!PngTexture_CheckRow(reference, encoder, bitsPerPixel, width, &seed)) {
+                        fprintf(stderr, "Error: %s %s encoder from %s pixels differs from the scalar one at width %zu\n",
+                                sIsaNames[isa], sTextureTypeNames[type], sLayoutNames[layout], width);
+                        failed++;
+                        ok = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        printf("%s: %zu encoders checked, %zu differ\n", sIsaNames[isa], checked, failed);
     }
 
-    dst->hasData = true;
+    return ok;
 }
 
 uint32_t PngTexture_BitsPerPixel(TextureType texType) {